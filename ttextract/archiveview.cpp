@@ -0,0 +1,283 @@
+// archiveview.cpp : Parsing of .DAT archive tables from memory.
+
+#include "include/archiveview.h"
+#include "include/filereading.h"
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <utility>
+#include <vector>
+
+namespace {
+
+const std::vector<int> validSignatures{-1, -2, -3, -4};
+
+constexpr size_t fileInfoEntrySize = 16;
+constexpr size_t nameInfoEntrySize = 8;
+// Table words byte swapped per pass of a bulk decode, small enough for the
+// stack
+constexpr size_t wordsPerBlock = 1024;
+
+ttError fail(ttError error, std::string *detail, std::string message) {
+  if (detail) {
+    *detail = std::move(message);
+  }
+  return error;
+}
+
+// Subspan of archive at offset, or false if it runs past the end.
+bool table(std::span<const std::byte> archive, uint64_t offset, uint64_t size,
+           std::span<const std::byte> &out) {
+  if (offset > archive.size() || size > archive.size() - offset) {
+    return false;
+  }
+  out = archive.subspan(offset, size);
+  return true;
+}
+
+ttError truncated(std::string *detail, std::string_view what, uint64_t offset) {
+  return fail(ttError::truncated, detail,
+              std::format("{} at 0x{:<8X} runs past end of file", what, offset));
+}
+
+// Offset of the file info table given by the header. If larger than end of
+// file, try 2s complement >> 8.
+template <ENDIAN endianness>
+uint64_t headerInfoOffset(std::span<const std::byte> header, uint64_t fileSize) {
+  uint64_t offset = readUint32<endianness>(header, 0);
+  if (offset > fileSize) {
+    offset = static_cast<uint64_t>(~static_cast<uint32_t>(offset) + 1) << 8;
+  }
+  return offset;
+}
+
+// Whether the header read in this byte order describes a file of fileSize
+template <ENDIAN endianness>
+bool headerMatches(std::span<const std::byte> header, uint64_t fileSize) {
+  return headerInfoOffset<endianness>(header, fileSize) +
+             readUint32<endianness>(header, 4) ==
+         fileSize;
+}
+
+} // namespace
+
+template <ENDIAN endianness>
+ttError ArchiveView::parseTables(std::string *detail) {
+  auto fileSize = archive.size();
+  auto header = archive.first(8);
+  uint64_t fileInfoOffset = headerInfoOffset<endianness>(header, fileSize);
+  infoSize = readUint32<endianness>(header, 4);
+  auto expectedSize = fileInfoOffset + infoSize;
+  if (expectedSize != fileSize) {
+    return fail(ttError::sizeMismatch, detail,
+                std::format("Size mismatch. Expected 0x{:<8X}, got 0x{:<8X}",
+                            expectedSize, fileSize));
+  }
+
+  // File info section
+  std::span<const std::byte> infoHeader;
+  if (!table(archive, fileInfoOffset, 8, infoHeader)) {
+    return truncated(detail, "File info header", fileInfoOffset);
+  }
+  sig = readInt32<endianness>(infoHeader, 0);
+  if (!std::count(validSignatures.begin(), validSignatures.end(), sig)) {
+    return fail(ttError::badSignature, detail,
+                std::format("File signature {} invalid.", sig));
+  }
+  fileCount = readUint32<endianness>(infoHeader, 4);
+  if (!table(archive, fileInfoOffset + 8, uint64_t{fileCount} * fileInfoEntrySize,
+             fileInfoTable)) {
+    return truncated(detail, "File info", fileInfoOffset + 8);
+  }
+
+  // Name info section
+  uint64_t offset = tableOffset(fileInfoTable) + fileInfoTable.size();
+  std::span<const std::byte> count;
+  if (!table(archive, offset, 4, count)) {
+    return truncated(detail, "Name count", offset);
+  }
+  nameCount = readUint32<endianness>(count, 0);
+  if (!table(archive, offset + 4, uint64_t{nameCount} * nameInfoEntrySize,
+             nameInfoTable)) {
+    return truncated(detail, "Name info", offset + 4);
+  }
+
+  // Name data section
+  offset = tableOffset(nameInfoTable) + nameInfoTable.size();
+  if (!table(archive, offset, 4, count)) {
+    return truncated(detail, "Name data size", offset);
+  }
+  uint32_t nameDataSize = readUint32<endianness>(count, 0);
+  if (!table(archive, offset + 4, nameDataSize, nameData)) {
+    return truncated(detail, "Name data", offset + 4);
+  }
+
+  // CRC section
+  offset = nameCRCOffset();
+  if (offset != fileSize) {
+    std::span<const std::byte> first;
+    if (!table(archive, offset, 4, first)) {
+      return truncated(detail, "Name CRCs", offset);
+    }
+    if (readUint32<endianness>(first, 0)) {
+      if (!table(archive, offset, uint64_t{fileCount} * 4, crcTable)) {
+        return truncated(detail, "Name CRCs", offset);
+      }
+      offset += crcTable.size();
+      // Should have two dwords left, expecting zeroes
+      std::span<const std::byte> end;
+      if (!table(archive, offset, 8, end)) {
+        return truncated(detail, "CRC terminator", offset);
+      }
+      if (readUint32<endianness>(end, 0) || readUint32<endianness>(end, 4)) {
+        return fail(ttError::badTrailer, detail,
+                    std::format("Unexpected non-zero bytes at 0x{:<8X}", offset));
+      }
+      offset += 8;
+      if (offset != fileSize) {
+        return fail(ttError::badTrailer, detail,
+                    std::format("Unexpected non-zero data at 0x{:<8X}", offset));
+      }
+    }
+  }
+  return ttError::none;
+}
+
+ttError ArchiveView::parse(std::span<const std::byte> archive,
+                           std::string *detail) {
+  *this = ArchiveView();
+  this->archive = archive;
+  std::span<const std::byte> header;
+  if (!table(archive, 0, 8, header)) {
+    return truncated(detail, "Header", 0);
+  }
+  // Only the right byte order makes the header add up to the file size
+  if (!headerMatches<ENDIAN::little>(header, archive.size()) &&
+      headerMatches<ENDIAN::big>(header, archive.size())) {
+    order = ENDIAN::big;
+  }
+  return order == ENDIAN::big ? parseTables<ENDIAN::big>(detail)
+                              : parseTables<ENDIAN::little>(detail);
+}
+
+datFileInfo ArchiveView::unpackFileInfo(const uint32_t *words) const {
+  datFileInfo info;
+  info.offset = words[0];
+  if (sig != -1) {
+    info.offset <<= 8;
+  }
+  info.packedSize = words[1];
+  info.unpackedSize = words[2];
+  info.packedType = words[3] & 0xFF;
+  info.offset += words[3] >> 24;
+  return info;
+}
+
+// The two 16 bit fields share the first word, in the order the table stores
+// them
+template <ENDIAN endianness>
+datNameInfo ArchiveView::unpackNameInfo(const uint32_t *words) {
+  auto first = static_cast<int16_t>(words[0] & 0xFFFF);
+  auto second = static_cast<int16_t>(words[0] >> 16);
+  if constexpr (endianness == ENDIAN::big) {
+    std::swap(first, second);
+  }
+  return {first, second, words[1]};
+}
+
+template <ENDIAN endianness>
+void ArchiveView::decodeFileInfos(uint32_t first,
+                                  std::span<datFileInfo> out) const {
+  constexpr size_t wordsPerEntry = fileInfoEntrySize / 4;
+  uint32_t words[wordsPerBlock];
+  for (size_t done = 0; done < out.size();) {
+    size_t count = std::min(out.size() - done, wordsPerBlock / wordsPerEntry);
+    readUint32s<endianness>(fileInfoTable, (first + done) * fileInfoEntrySize,
+                            std::span(words, count * wordsPerEntry));
+    for (size_t i = 0; i < count; ++i) {
+      out[done + i] = unpackFileInfo(words + i * wordsPerEntry);
+    }
+    done += count;
+  }
+}
+
+template <ENDIAN endianness>
+void ArchiveView::decodeNameInfos(uint32_t first,
+                                  std::span<datNameInfo> out) const {
+  constexpr size_t wordsPerEntry = nameInfoEntrySize / 4;
+  uint32_t words[wordsPerBlock];
+  for (size_t done = 0; done < out.size();) {
+    size_t count = std::min(out.size() - done, wordsPerBlock / wordsPerEntry);
+    readUint32s<endianness>(nameInfoTable, (first + done) * nameInfoEntrySize,
+                            std::span(words, count * wordsPerEntry));
+    for (size_t i = 0; i < count; ++i) {
+      out[done + i] = unpackNameInfo<endianness>(words + i * wordsPerEntry);
+    }
+    done += count;
+  }
+}
+
+datFileInfo ArchiveView::fileInfo(uint32_t index) const {
+  datFileInfo info;
+  fileInfos(index, std::span(&info, 1));
+  return info;
+}
+
+datNameInfo ArchiveView::nameInfo(uint32_t index) const {
+  datNameInfo info;
+  nameInfos(index, std::span(&info, 1));
+  return info;
+}
+
+void ArchiveView::fileInfos(uint32_t first, std::span<datFileInfo> out) const {
+  if (order == ENDIAN::big) {
+    decodeFileInfos<ENDIAN::big>(first, out);
+  } else {
+    decodeFileInfos<ENDIAN::little>(first, out);
+  }
+}
+
+void ArchiveView::nameInfos(uint32_t first, std::span<datNameInfo> out) const {
+  if (order == ENDIAN::big) {
+    decodeNameInfos<ENDIAN::big>(first, out);
+  } else {
+    decodeNameInfos<ENDIAN::little>(first, out);
+  }
+}
+
+uint32_t ArchiveView::crc(uint32_t index) const {
+  return readUint32(crcTable, index * size_t{4}, order);
+}
+
+void ArchiveView::crcs(std::span<uint32_t> out) const {
+  out = out.first(std::min(out.size(), crcTable.size() / 4));
+  if (order == ENDIAN::big) {
+    readUint32s<ENDIAN::big>(crcTable, 0, out);
+  } else {
+    readUint32s<ENDIAN::little>(crcTable, 0, out);
+  }
+}
+
+std::string_view ArchiveView::name(uint32_t nameOffset) const {
+  if (nameOffset >= nameData.size()) {
+    return {};
+  }
+  auto *start = reinterpret_cast<const char *>(nameData.data()) + nameOffset;
+  size_t remaining = nameData.size() - nameOffset;
+  auto *end = static_cast<const char *>(std::memchr(start, 0, remaining));
+  return {start, end ? static_cast<size_t>(end - start) : remaining};
+}
+
+bool ArchiveView::nameInBounds(uint32_t nameOffset) const {
+  return nameOffset < nameData.size() &&
+         std::memchr(nameData.data() + nameOffset, 0,
+                     nameData.size() - nameOffset) != nullptr;
+}
+
+std::span<const std::byte>
+ArchiveView::payload(const datFileInfo &info) const {
+  if (!inBounds(info)) {
+    return {};
+  }
+  return archive.subspan(info.offset, info.packedSize);
+}
@@ -1,6 +1,10 @@
+#include <climits>
 #include <unordered_map>
+#include <vector>
 #include <stdexcept>
 #include <iostream>
+#include <fstream>
+#include <filesystem>
 #include "ttextract.h"
 
 const std::unordered_map<std::string_view, argType> validArgs = {
@@ -11,7 +15,24 @@ const std::unordered_map<std::string_view, argType> validArgs = {
     {"-a", argType::ALG},       {"--alg", argType::ALG},
     {"-r", argType::RAW},       {"--raw", argType::RAW},
     {"-d", argType::DIRECTORY}, {"--directory", argType::DIRECTORY},
-    {"-o", argType::OUTFILE},   {"--out", argType::OUTFILE} };
+    {"-o", argType::OUTFILE},   {"--out", argType::OUTFILE},
+    {"-b", argType::BENCH},     {"--bench", argType::BENCH},
+    {"-j", argType::JOBS},      {"--jobs", argType::JOBS},
+    {"-l", argType::LIST},      {"--list", argType::LIST},
+    {"--json", argType::JSON},
+    {"-i", argType::INCLUDE},   {"--include", argType::INCLUDE},
+    {"-x", argType::EXCLUDE},   {"--exclude", argType::EXCLUDE},
+    {"-c", argType::TOSTDOUT},  {"--to-stdout", argType::TOSTDOUT},
+    {"-t", argType::TAR},       {"--tar", argType::TAR},
+    {"--incremental", argType::INCREMENTAL},
+    {"--stats", argType::STATS},
+    {"--verify", argType::VERIFY},
+    {"--pack", argType::PACK},
+    {"--signature", argType::SIGNATURE},
+    {"--level", argType::LEVEL},
+    {"--diff", argType::DIFF},
+    {"--dedupe", argType::DEDUPE},
+    {"--dedupe-content", argType::DEDUPECONTENT} };
 
 const std::unordered_map<std::string_view, algType> validAlgs = {
     {"none", algType::NONE},
@@ -19,6 +40,18 @@ const std::unordered_map<std::string_view, algType> validAlgs = {
     {"lz2k", algType::LZ2K},
     {"2", algType::LZ2K} };
 
+// Largest -j accepted; more workers than this only add contention
+constexpr long long maxJobs = 1024;
+
+// The value following option args[i], advancing i past it
+std::string_view optionValue(const std::vector<std::string_view>& args, int& i) {
+    if (i + 1 >= static_cast<int>(args.size())) {
+        logError("Option \"" + static_cast<std::string>(args[i]) + "\" requires a value");
+        throw 1;
+    }
+    return args[++i];
+}
+
 std::string stripExt(std::string fileName) {
     auto pivot = fileName.rfind('.');
     if (pivot == std::string::npos) {
@@ -27,12 +60,58 @@ std::string stripExt(std::string fileName) {
     return fileName.substr(0, pivot);
 }
 
+// Add an archive named on the command line, or every archive listed in a
+// response file given as @path: one per line, skipping blank lines and lines
+// starting with #.
+void addFileName(std::string_view arg, std::vector<std::string>& fileNames) {
+    if (!arg.starts_with('@')) {
+        fileNames.emplace_back(arg);
+        return;
+    }
+    std::ifstream list(static_cast<std::string>(arg.substr(1)));
+    if (!list) {
+        logError("Cannot open response file \"" + static_cast<std::string>(arg.substr(1)) + '\"');
+        throw 1;
+    }
+    std::string line;
+    while (std::getline(list, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!line.empty() && !line.starts_with('#')) {
+            fileNames.push_back(line);
+        }
+    }
+}
+
 void printHelpMessage() {
-    std::cout << "usage: ttextract.exe <filename> [options]\n"
-        << "  <filename>         Absolute or relative path to file.\n\n"
-        << "Archive options (.DAT, .FPK, .PAK files):\n"
+    std::cout << "usage: ttextract.exe <filename> [<filename>...] [options]\n"
+        << "  <filename>         Absolute or relative path to file. @<file> reads archive paths from <file>, one per line.\n"
+        << "                     Several archives are extracted one after another on one set of workers, each into a\n"
+        << "                     folder named after it (inside --directory, if given), which must be unique.\n\n"
+        << "Archive options (.DAT, .PAK files; .FPK isn't supported yet):\n"
         << "  -d, --directory    Directory name for output files. Defaults to file name without extension.\n"
-        << "  -r, --raw          Extract raw files, do not unpack compressed files in archive.\n\n"
+        << "  -r, --raw          Extract raw files, do not unpack compressed files in archive.\n"
+        << "  -j, --jobs         Number of files to extract in parallel. 0 uses every core. Defaults to 1.\n"
+        << "  -l, --list         List the archive contents without extracting anything.\n"
+        << "      --json         With --list, --stats or --diff, print the listing, statistics or changes as JSON.\n"
+        << "  -i, --include      Only extract or list files matching this pattern. May be repeated.\n"
+        << "  -x, --exclude      Skip files matching this pattern. May be repeated.\n"
+        << "  -c, --to-stdout    Write the contents of the selected files to standard output instead of to disk.\n"
+        << "  -t, --tar          Write the selected files to standard output as a tar archive.\n"
+        << "      --incremental  Only extract files that changed since the last extraction to the same directory.\n"
+        << "      --stats        Print time spent per phase (summed over workers), bytes in and out, compression\n"
+        << "                     ratio per algorithm and the slowest entries once extraction finishes.\n"
+        << "      --verify       Decode every file in memory and check it against the archive's tables instead of\n"
+        << "                     extracting. Exits with an error if any problem is found.\n"
+        << "      --dedupe       Write files that share their data in the archive once and hard link the other\n"
+        << "                     names to it (or copy, where links aren't supported). Linked files share edits.\n"
+        << "      --dedupe-content Like --dedupe, also matching files stored twice with identical contents.\n"
+        << "      --diff         Compare the archive with the given newer one, listing files added, removed,\n"
+        << "                     moved (same data at a new offset), resized or changed. Files whose sizes match\n"
+        << "                     have their data compared too.\n"
+        << "  Patterns are case-insensitive globs over the archive path, e.g. \"*\\LEVELS\\*.GSC\",\n"
+        << "  where * also matches across folders. Prefix with \"re:\" for a regular expression.\n\n"
         << "Single file options:\n"
         << "  -u, --unpack       (REQUIRED) Indicates the file is a compressed file rather than an archive.\n"
         << "  -s, --size         Size of extracted file. If not specified, program will not check output size.\n"
@@ -41,15 +120,24 @@ void printHelpMessage() {
         << "  Algorithm options:\n"
         << "      0, none        No compression algorithm (outputs as-is)\n"
         << "      2, lz2k        LZ2K compression algorithm\n"
-        << "  -o, --out          Output file name. Defaults to file name with \".dec\" appended.\n\n";
+        << "  -o, --out          Output file name. Defaults to file name with \".dec\" appended.\n"
+        << "  -b, --bench        Decode the file the given number of times and report throughput.\n\n"
+        << "Packing options:\n"
+        << "      --pack         (REQUIRED) Build a .DAT archive from the folder <filename> instead of extracting.\n"
+        << "  -o, --out          Output archive name. Defaults to the folder name with \".DAT\" appended.\n"
+        << "      --signature    Archive signature, -1 to -4. Defaults to -3.\n"
+        << "      --level        LZ2K compression level, 1 (fastest) to 9 (smallest). Defaults to 5.\n"
+        << "  -j, -i and -x work as for extraction; patterns match the paths inside the archive.\n\n";
 }
 
+// Messages are written in one call so lines from worker threads don't mix.
+// Warnings go to stderr so they can't corrupt --to-stdout or --tar output.
 void logWarning(std::string message) {
-    std::cout << "[WARNING] " << message << '\n';
+    std::cerr << "[WARNING] " + message + '\n';
 }
 
 void logError(std::string message) {
-    std::cerr << "[ERROR] " << message << '\n';
+    std::cerr << "[ERROR] " + message + '\n';
 }
 
 cmdlineArgs parseArgs(int argc, char* argv[]) {
@@ -59,8 +147,10 @@ cmdlineArgs parseArgs(int argc, char* argv[]) {
     }
     const std::vector<std::string_view> args(argv + 1, argv + argc);
     cmdlineArgs results;
-    // First argument is ALWAYS filename.
+    // First argument is ALWAYS filename. More archives may follow anywhere
+    // among the options.
     results.fileName = args[0];
+    addFileName(args[0], results.fileNames);
     for (int i = 1; i < args.size(); ++i) {
         auto& arg = args[i];
         std::string_view value;
@@ -68,7 +158,11 @@ cmdlineArgs parseArgs(int argc, char* argv[]) {
         try {
             ref = validArgs.at(arg);
         }
-        catch (std::out_of_range error) {
+        catch (const std::out_of_range&) {
+            if (!arg.starts_with('-')) {
+                addFileName(arg, results.fileNames);
+                continue;
+            }
             logError("Unrecognized option \"" + static_cast<std::string>(arg) + '\"');
             throw 1;
         }
@@ -91,14 +185,16 @@ cmdlineArgs parseArgs(int argc, char* argv[]) {
                 logError("Only one size can be specified.");
                 throw 1;
             }
-            value = args[++i];
+            value = optionValue(args, i);
             try {
-                results.size = std::stol(static_cast<std::string>(value), nullptr, 0);
+                auto parsed = std::stoll(static_cast<std::string>(value), nullptr, 0);
+                results.size = parsed <= INT_MAX ? static_cast<int>(parsed) : -1;
             }
-            catch (std::invalid_argument) {
-                logWarning("Ignoring size - invalid argument");
+            catch (const std::invalid_argument&) {
+                results.size = -1;
+            }
+            catch (const std::out_of_range&) {
                 results.size = -1;
-                break;
             }
             if (results.size < 0) {
                 logWarning("Ignoring size - invalid argument");
@@ -116,14 +212,16 @@ cmdlineArgs parseArgs(int argc, char* argv[]) {
                 logError("Only one packed size can be specified.");
                 throw 1;
             }
-            value = args[++i];
+            value = optionValue(args, i);
             try {
-                results.packedSize = std::stol(static_cast<std::string>(value), nullptr, 0);
+                auto parsed = std::stoll(static_cast<std::string>(value), nullptr, 0);
+                results.packedSize = parsed <= INT_MAX ? static_cast<int>(parsed) : -1;
             }
-            catch (std::invalid_argument) {
-                logWarning("Ignoring packed size - invalid argument");
+            catch (const std::invalid_argument&) {
+                results.packedSize = -1;
+            }
+            catch (const std::out_of_range&) {
                 results.packedSize = -1;
-                break;
             }
             if (results.packedSize < 0) {
                 logWarning("Ignoring packed size - invalid argument");
@@ -141,12 +239,12 @@ cmdlineArgs parseArgs(int argc, char* argv[]) {
                 logError("Only one algorithm can be specified.");
                 throw 1;
             }
-            value = args[++i];
+            value = optionValue(args, i);
             try {
                 algType type = validAlgs.at(value);
                 results.alg = type;
             }
-            catch (std::out_of_range error) {
+            catch (const std::out_of_range&) {
                 logError("Unrecognized algorithm \"" + static_cast<std::string>(value) + '\"');
                 throw 1;
             }
@@ -163,26 +261,213 @@ cmdlineArgs parseArgs(int argc, char* argv[]) {
                 logError("Option \"" + static_cast<std::string>(arg) + "\" incompatible with -u or --unpack");
                 throw 1;
             }
-            value = args[++i];
+            value = optionValue(args, i);
             results.outDir = value;
             break;
         case OUTFILE:
+            if (!results.isUnpack && !results.isPack) {
+                logError("Option \"" + static_cast<std::string>(arg) + "\" requires -u, --unpack or --pack");
+                throw 1;
+            }
+            value = optionValue(args, i);
+            results.outName = value;
+            break;
+        case JOBS:
+            if (results.isUnpack) {
+                logError("Option \"" + static_cast<std::string>(arg) + "\" incompatible with -u or --unpack");
+                throw 1;
+            }
+            value = optionValue(args, i);
+            {
+                long long jobs = -1;
+                try {
+                    jobs = std::stoll(static_cast<std::string>(value), nullptr, 0);
+                }
+                catch (const std::invalid_argument&) {}
+                catch (const std::out_of_range&) {}
+                // 0 asks for one job per core
+                if (jobs < 0 || jobs > maxJobs) {
+                    logError("Invalid value \"" + static_cast<std::string>(value) + "\" for \"" +
+                        static_cast<std::string>(arg) + "\", expected 0 to " + std::to_string(maxJobs));
+                    throw 1;
+                }
+                results.jobs = static_cast<unsigned>(jobs);
+            }
+            break;
+        case LIST:
+            if (results.isUnpack) {
+                logError("Option \"" + static_cast<std::string>(arg) + "\" incompatible with -u or --unpack");
+                throw 1;
+            }
+            results.isList = true;
+            break;
+        case JSON:
+            if (results.isUnpack) {
+                logError("Option \"" + static_cast<std::string>(arg) + "\" incompatible with -u or --unpack");
+                throw 1;
+            }
+            results.isJson = true;
+            break;
+        case INCLUDE:
+        case EXCLUDE:
+            if (results.isUnpack) {
+                logError("Option \"" + static_cast<std::string>(arg) + "\" incompatible with -u or --unpack");
+                throw 1;
+            }
+            value = optionValue(args, i);
+            (ref == INCLUDE ? results.includes : results.excludes).emplace_back(value);
+            break;
+        case TOSTDOUT:
+        case TAR:
+            if (results.isUnpack) {
+                logError("Option \"" + static_cast<std::string>(arg) + "\" incompatible with -u or --unpack");
+                throw 1;
+            }
+            (ref == TAR ? results.isTar : results.toStdout) = true;
+            break;
+        case INCREMENTAL:
+            if (results.isUnpack) {
+                logError("Option \"" + static_cast<std::string>(arg) + "\" incompatible with -u or --unpack");
+                throw 1;
+            }
+            results.isIncremental = true;
+            break;
+        case STATS:
+            if (results.isUnpack) {
+                logError("Option \"" + static_cast<std::string>(arg) + "\" incompatible with -u or --unpack");
+                throw 1;
+            }
+            results.isStats = true;
+            break;
+        case VERIFY:
+            if (results.isUnpack) {
+                logError("Option \"" + static_cast<std::string>(arg) + "\" incompatible with -u or --unpack");
+                throw 1;
+            }
+            results.isVerify = true;
+            break;
+        case DEDUPE:
+        case DEDUPECONTENT:
+            if (results.isUnpack) {
+                logError("Option \"" + static_cast<std::string>(arg) + "\" incompatible with -u or --unpack");
+                throw 1;
+            }
+            results.isDedupe = true;
+            results.isDedupeContent = results.isDedupeContent || ref == DEDUPECONTENT;
+            break;
+        case DIFF:
+            if (results.isUnpack) {
+                logError("Option \"" + static_cast<std::string>(arg) + "\" incompatible with -u or --unpack");
+                throw 1;
+            }
+            value = optionValue(args, i);
+            results.diffName = value;
+            break;
+        case PACK:
+            if (results.isUnpack) {
+                logError("Option \"" + static_cast<std::string>(arg) + "\" incompatible with -u or --unpack");
+                throw 1;
+            }
+            results.isArchive = false;
+            results.isPack = true;
+            break;
+        case SIGNATURE:
+        case LEVEL:
+            if (!results.isPack) {
+                logError("Option \"" + static_cast<std::string>(arg) + "\" requires --pack");
+                throw 1;
+            }
+            value = optionValue(args, i);
+            try {
+                (ref == SIGNATURE ? results.signature : results.level) =
+                    std::stoi(static_cast<std::string>(value), nullptr, 0);
+            }
+            catch (const std::invalid_argument&) {
+                logError("Invalid value \"" + static_cast<std::string>(value) + "\" for \"" + static_cast<std::string>(arg) + '\"');
+                throw 1;
+            }
+            catch (const std::out_of_range&) {
+                logError("Value for \"" + static_cast<std::string>(arg) + "\" out of range");
+                throw 1;
+            }
+            if (ref == SIGNATURE ? results.signature < -4 || results.signature > -1
+                                 : results.level < 1 || results.level > 9) {
+                logError("Value for \"" + static_cast<std::string>(arg) + "\" out of range");
+                throw 1;
+            }
+            break;
+        case BENCH:
             if (!results.isUnpack) {
                 logError("Option \"" + static_cast<std::string>(arg) + "\" requires -u or --unpack");
                 throw 1;
             }
-            value = args[++i];
-            results.outName = value;
+            value = optionValue(args, i);
+            try {
+                results.benchRuns = std::stoi(static_cast<std::string>(value), nullptr, 0);
+            }
+            catch (const std::invalid_argument&) {
+                logWarning("Ignoring bench runs - invalid argument");
+                results.benchRuns = 0;
+            }
+            catch (const std::out_of_range&) {
+                logWarning("Ignoring bench runs - invalid argument");
+                results.benchRuns = 0;
+            }
             break;
         }
     }
-    // Default outDir or outName
-    if (results.isArchive && results.outDir == "") {
+    if (results.isJson && !results.isList && !results.isStats && results.diffName.empty()) {
+        logError("Option \"--json\" requires -l, --list, --stats or --diff");
+        throw 1;
+    }
+    if (results.isStats && results.isList) {
+        logError("Options \"--stats\" and \"--list\" can't be combined");
+        throw 1;
+    }
+    if (results.isVerify && (results.isList || results.isTar || results.toStdout || results.isIncremental)) {
+        logError("Option \"--verify\" can't be combined with --list, --to-stdout, --tar or --incremental");
+        throw 1;
+    }
+    if (!results.diffName.empty() && (results.isList || results.isTar || results.toStdout ||
+        results.isIncremental || results.isStats || results.isVerify || results.isPack)) {
+        logError("Option \"--diff\" can only be combined with -j, -i, -x and --json");
+        throw 1;
+    }
+    if (results.isDedupe && (results.isList || results.isTar || results.toStdout || results.isVerify ||
+        results.isPack || !results.diffName.empty())) {
+        logError("Option \"--dedupe\" only applies when extracting to disk");
+        throw 1;
+    }
+    if (results.fileNames.size() == 1 && !args[0].starts_with('@')) {
+        results.fileNames.clear();
+    }
+    else if (results.isUnpack || results.isList || results.isJson || results.isTar || results.toStdout ||
+             results.isVerify || results.isPack || !results.diffName.empty()) {
+        logError("Only -d, -r, -j, -i, -x, --incremental, --stats and --dedupe can be used with more than one archive");
+        throw 1;
+    }
+    else if (results.fileNames.empty()) {
+        logError("No archives listed in " + static_cast<std::string>(args[0].substr(1)));
+        throw 1;
+    }
+    if (results.isTar && results.toStdout) {
+        logError("Options \"--tar\" and \"--to-stdout\" can't be combined");
+        throw 1;
+    }
+    // Default outDir or outName; batches pick one per archive
+    if (results.isArchive && results.outDir == "" && results.fileNames.empty()) {
         results.outDir = stripExt(static_cast<std::string>(results.fileName));
     }
     else if (results.isUnpack && results.outName == "") {
         results.outName = static_cast<std::string>(results.fileName) + ".dec";
     }
+    else if (results.isPack && results.outName == "") {
+        std::filesystem::path folder(results.fileName);
+        if (!folder.has_filename()) {
+            folder = folder.parent_path(); // "LEVELS/" packs to "LEVELS.DAT"
+        }
+        results.outName = folder.string() + ".DAT";
+    }
     // Default to raw output
     if (results.alg == algType::UNSPECIFIED) {
         results.alg = algType::NONE;
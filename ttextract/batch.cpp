@@ -0,0 +1,138 @@
+// batch.cpp : Extract several archives in one run on a shared worker pool.
+
+#include "ttextract.h"
+#include "include/archiveview.h"
+#include "include/datindex.h"
+#include "include/extractstats.h"
+#include "include/filereading.h"
+#include "include/mappedfile.h"
+#include "include/pathfilter.h"
+#include "include/threadpool.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// One archive of the batch, kept at a fixed address since its index points
+// at its view
+struct batchArchive {
+  cmdlineArgs args;
+  MappedFile file;
+  ArchiveView view;
+  DatIndex index;
+  std::unique_ptr<ExtractStats> stats;
+  // When it was ready to extract, for --stats to leave out the wait until
+  // its turn
+  ExtractStats::clock::time_point opened;
+};
+
+void checkArchive(ttError error, const std::string &name,
+                  const std::string &detail) {
+  if (error != ttError::none) {
+    logError(std::format("{}: {}", name, detail.empty() ? describe(error) : detail));
+    throw 1;
+  }
+}
+
+// Each archive gets a folder named after it, like a single extraction, but
+// inside outDir if one was given
+std::string batchOutDir(const std::string &outDir, const std::string &name) {
+  if (outDir.empty()) {
+    return stripExt(name);
+  }
+  return (std::filesystem::path(outDir) / std::filesystem::path(name).stem())
+      .string();
+}
+
+// outDir as compared for collisions: archives from different folders with
+// the same name would share one with -d, and Windows ignores case
+std::string outDirKey(const std::string &outDir) {
+  auto key = std::filesystem::path(outDir).lexically_normal().generic_string();
+  std::transform(key.begin(), key.end(), key.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  return key;
+}
+
+} // namespace
+
+void handleBatch(const cmdlineArgs &args) {
+  // Every archive needs a folder of its own, or their files would land in
+  // one and overwrite each other
+  std::unordered_map<std::string, const std::string *> outDirs;
+  for (auto &name : args.fileNames) {
+    auto outDir = batchOutDir(args.outDir, name);
+    auto [other, added] = outDirs.emplace(outDirKey(outDir), &name);
+    if (!added) {
+      logError(std::format("{} and {} would both extract to {}; rename one or "
+                           "extract them separately.",
+                           *other->second, name, outDir));
+      throw 1;
+    }
+  }
+
+  // Open and resolve every archive before writing anything, so a bad one
+  // stops the batch up front rather than halfway through
+  auto filter = makeFilter(args);
+  std::vector<std::unique_ptr<batchArchive>> archives;
+  std::string detail;
+  for (auto &name : args.fileNames) {
+    auto archive = std::make_unique<batchArchive>();
+    archive->file = MappedFile(name);
+    if (!archive->file.isOpen()) {
+      logError(std::format("Cannot open source file {}.", name));
+      throw 1;
+    }
+    auto src = archive->file.bytes();
+    if (src.size() >= 4 && readUint32(src, 0, ENDIAN::little) == 0x12345678) {
+      logError(std::format("{}: .FPK archives aren't supported yet.", name));
+      throw 1;
+    }
+    if (args.isStats) {
+      archive->stats = std::make_unique<ExtractStats>(
+          ThreadPool::workerCount(args.jobs), slowestEntries);
+    }
+    auto *stats = archive->stats.get();
+    {
+      ExtractStats::timer timing(stats, 0, statPhase::PARSE);
+      checkArchive(archive->view.parse(src, &detail), name, detail);
+    }
+    {
+      ExtractStats::timer timing(stats, 0, statPhase::RESOLVE);
+      checkArchive(archive->index.build(archive->view, &filter, &detail), name,
+                   detail);
+    }
+    {
+      ExtractStats::timer timing(stats, 0, statPhase::VALIDATE);
+      checkArchive(archive->index.validate(&detail), name, detail);
+    }
+    archive->args = args;
+    archive->args.fileName = name;
+    archive->args.outDir = batchOutDir(args.outDir, name);
+    archive->opened = ExtractStats::clock::now();
+    archives.push_back(std::move(archive));
+  }
+
+  // One archive after another, each the same way as on its own: the whole
+  // pool sweeps through its data in file order with read ahead
+  ThreadPool pool(args.jobs);
+  size_t extracted = 0;
+  for (auto &archive : archives) {
+    std::cout << std::format("{}: {} files -> {}\n", archive->args.fileName,
+                             archive->index.files().size(), archive->args.outDir);
+    if (archive->stats) {
+      archive->stats->skipWait(ExtractStats::clock::now() - archive->opened);
+    }
+    extracted += extractDAT(archive->file, archive->index, archive->args, pool,
+                            archive->stats.get());
+  }
+  std::cout << std::format("Extracted {} files from {} archives\n", extracted,
+                           archives.size());
+}
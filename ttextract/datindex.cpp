@@ -0,0 +1,251 @@
+// datindex.cpp : Resolve a .DAT name tree into a flat item table.
+
+#include "include/datindex.h"
+#include <algorithm>
+#include <array>
+#include <format>
+#include <utility>
+
+namespace {
+
+// What each byte contributes to the hash: toupper() of a plain (signed) char
+// as the MSVC runtime computes it, so ASCII letters are upper-cased and bytes
+// from 0x80 up are sign extended. A table keeps that the same everywhere;
+// glibc's toupper() would map those bytes to 0x80-0xFF instead.
+constexpr std::array<uint32_t, 256> hashFold = [] {
+  std::array<uint32_t, 256> fold{};
+  for (uint32_t c = 0; c < 256; ++c) {
+    fold[c] = c >= 'a' && c <= 'z' ? c - 'a' + 'A'
+              : c >= 0x80          ? c | 0xFFFFFF00
+                                   : c;
+  }
+  return fold;
+}();
+
+// CRC -> file index lookup over the CRC section. The tables are normally
+// written sorted, in which case they're searched as they are; otherwise a
+// sorted copy is made. As before, a duplicated CRC maps to its last file.
+class crcLookup {
+public:
+  explicit crcLookup(const ArchiveView &archive) {
+    auto count = archive.hasCRCs() ? archive.numFiles() : 0;
+    crcs.resize(count);
+    archive.crcs(crcs);
+    bool sorted = std::is_sorted(crcs.begin(), crcs.end());
+    if (!sorted) {
+      files.resize(count);
+      for (uint32_t i = 0; i < count; ++i) {
+        files[i] = i;
+      }
+      std::stable_sort(files.begin(), files.end(), [&](uint32_t a, uint32_t b) {
+        return crcs[a] < crcs[b];
+      });
+      std::sort(crcs.begin(), crcs.end());
+    }
+  }
+
+  // File index with this CRC, or datIndexEntry::noFile
+  [[nodiscard]] uint32_t find(uint32_t crc) const {
+    auto last = std::upper_bound(crcs.begin(), crcs.end(), crc);
+    if (last == crcs.begin() || *(last - 1) != crc) {
+      return datIndexEntry::noFile;
+    }
+    auto position = static_cast<uint32_t>(last - crcs.begin() - 1);
+    return files.empty() ? position : files[position];
+  }
+
+private:
+  std::vector<uint32_t> crcs;
+  // Original index of each sorted CRC, empty if the table was already sorted
+  std::vector<uint32_t> files;
+};
+
+ttError fail(ttError error, std::string *detail, std::string message) {
+  if (detail) {
+    *detail = std::move(message);
+  }
+  return error;
+}
+
+} // namespace
+
+uint32_t pathHashAppend(uint32_t crc, std::string_view text) {
+  for (char c : text) {
+    crc = (crc ^ hashFold[static_cast<uint8_t>(c)]) * FNV_PRIME;
+  }
+  return crc;
+}
+
+uint32_t pathHash(std::string_view path) {
+  return path.empty() ? FNV_BASIS : pathHashAppend(FNV_BASIS, path.substr(1));
+}
+
+ttError DatIndex::build(const ArchiveView &archive, const PathFilter *filter,
+                        std::string *detail) {
+  view = &archive;
+  items.clear();
+  fileItems.clear();
+  if (filter && filter->empty()) {
+    filter = nullptr;
+  }
+  crcLookup crcToIndex(archive);
+
+  auto numNames = archive.numNames();
+  items.reserve(numNames);
+  std::vector<datNameInfo> nameInfos(numNames);
+  archive.nameInfos(0, nameInfos);
+  // Whether an item's path is non-empty; folders with one become the current
+  // directory for the items that follow them
+  std::vector<bool> hasPath(numNames);
+  // Whether an item lies in a folder the filter rejected as a whole
+  std::vector<bool> pruned(numNames);
+  // Hash of each item's path, built from its parent's so every name is only
+  // hashed once
+  std::vector<uint32_t> hashes(archive.hasCRCs() ? numNames : 0);
+  uint32_t currentDir = datIndexEntry::noParent;
+  std::string scratch;
+  for (uint32_t item = 0; item < numNames; ++item) {
+    const auto &nameInfo = nameInfos[item];
+    uint32_t parent = currentDir;
+    if (nameInfo.pathType > 0) {
+      // Same directory as an earlier item
+      if (static_cast<uint32_t>(nameInfo.pathType) >= item) {
+        return fail(ttError::badNameTree, detail,
+                    std::format("Name {} refers to later name {}", item,
+                                nameInfo.pathType));
+      }
+      parent = items[nameInfo.pathType].parent;
+    }
+    auto itemName = archive.name(nameInfo.nameOffset);
+    bool named = !itemName.empty();
+    bool hasParent = parent != datIndexEntry::noParent;
+    bool parentHasPath = hasParent && hasPath[parent];
+    hasPath[item] = named || parentHasPath;
+    pruned[item] = hasParent && pruned[parent];
+    if (!hashes.empty()) {
+      uint32_t crc = parentHasPath ? hashes[parent] : FNV_BASIS;
+      if (named) {
+        // The separator before the first name isn't hashed
+        crc = pathHashAppend(parentHasPath ? pathHashAppend(crc, "\\") : crc,
+                             itemName);
+      }
+      hashes[item] = crc;
+    }
+
+    if (nameInfo.readType > 0) {
+      items.push_back({parent, nameInfo.nameOffset, datIndexEntry::noFile});
+      if (hasPath[item]) {
+        currentDir = item;
+      }
+      if (filter && !pruned[item]) {
+        scratch.clear();
+        appendPath(item, scratch);
+        pruned[item] = !filter->mayMatchUnder(scratch);
+      }
+      continue;
+    }
+
+    uint32_t fileIndex = -nameInfo.readType;
+    items.push_back({parent, nameInfo.nameOffset, fileIndex});
+    if (filter) {
+      if (!pruned[item]) {
+        scratch.clear();
+        appendPath(item, scratch);
+      }
+      if (pruned[item] || !filter->matches(scratch)) {
+        items.back().fileIndex = datIndexEntry::filteredOut;
+        continue;
+      }
+    }
+    if (archive.hasCRCs()) {
+      fileIndex = crcToIndex.find(hashes[item]);
+      if (fileIndex == datIndexEntry::noFile) {
+        return fail(ttError::crcMismatch, detail,
+                    std::format("CRC 0x{:<8X} doesn't correspond to a file",
+                                hashes[item]));
+      }
+      items.back().fileIndex = fileIndex;
+    }
+    if (fileIndex >= archive.numFiles()) {
+      return fail(ttError::fileIndexOutOfRange, detail,
+                  std::format("File index {} out of range", fileIndex));
+    }
+    fileItems.push_back(item);
+  }
+  return ttError::none;
+}
+
+ttError DatIndex::validate(std::string *detail) const {
+  for (uint32_t item = 0; item < items.size(); ++item) {
+    auto nameOffset = items[item].nameOffset;
+    auto itemName = view->name(nameOffset);
+    if (!itemName.empty() && !view->nameInBounds(nameOffset)) {
+      return fail(ttError::truncated, detail,
+                  std::format("Name {} at 0x{:X} runs past end of name data",
+                              item, nameOffset));
+    }
+    // Names become path components under the output folder, so none may
+    // climb out of it or name a drive
+    if (itemName == "." || itemName == ".." ||
+        itemName.find_first_of("/\\:") != std::string_view::npos) {
+      return fail(ttError::badNameTree, detail,
+                  std::format("Name {} \"{}\" isn't a valid file name", item,
+                              itemName));
+    }
+    if (itemName.empty() && !isFolder(item) &&
+        items[item].fileIndex != datIndexEntry::filteredOut) {
+      return fail(ttError::badNameTree, detail,
+                  std::format("File {} has no name", items[item].fileIndex));
+    }
+  }
+  std::vector<datFileInfo> fileInfos(view->numFiles());
+  view->fileInfos(0, fileInfos);
+  for (auto item : fileItems) {
+    const auto &info = fileInfos[items[item].fileIndex];
+    if (!view->inBounds(info)) {
+      return fail(ttError::truncated, detail,
+                  std::format("{}: data at 0x{:X} (0x{:X} bytes) runs past end of file",
+                              path(item), info.offset, info.packedSize));
+    }
+  }
+  return ttError::none;
+}
+
+void DatIndex::ancestry(uint32_t item, std::vector<uint32_t> &chain) const {
+  chain.clear();
+  for (; item != datIndexEntry::noParent; item = items[item].parent) {
+    chain.push_back(item);
+  }
+}
+
+void DatIndex::appendPath(uint32_t item, std::string &out) const {
+  thread_local std::vector<uint32_t> chain;
+  ancestry(item, chain);
+  for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+    auto itemName = name(*it);
+    if (!itemName.empty()) {
+      out += '\\';
+      out += itemName;
+    }
+  }
+}
+
+std::string DatIndex::path(uint32_t item) const {
+  std::string out;
+  appendPath(item, out);
+  return out;
+}
+
+std::filesystem::path
+DatIndex::outputPath(const std::filesystem::path &outDir, uint32_t item) const {
+  thread_local std::vector<uint32_t> chain;
+  ancestry(item, chain);
+  auto out = outDir;
+  for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+    auto itemName = name(*it);
+    if (!itemName.empty()) {
+      out /= itemName;
+    }
+  }
+  return out;
+}
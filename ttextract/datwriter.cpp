@@ -0,0 +1,260 @@
+// datwriter.cpp : Build .DAT archives.
+
+#include "include/datwriter.h"
+#include "include/datindex.h"
+#include <algorithm>
+#include <cctype>
+#include <format>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+// Signatures other than -1 store offsets in 256 byte units
+constexpr uint64_t blockAlignment = 0x100;
+// Name table entries refer to each other with signed 16 bit indices
+constexpr size_t maxNames = INT16_MAX + 1;
+
+ttError fail(ttError error, std::string *detail, std::string message) {
+  if (detail) {
+    *detail = std::move(message);
+  }
+  return error;
+}
+
+void putUint32(std::vector<std::byte> &dest, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    dest.push_back(static_cast<std::byte>(value >> (8 * i)));
+  }
+}
+
+void putUint16(std::vector<std::byte> &dest, uint16_t value) {
+  dest.push_back(static_cast<std::byte>(value));
+  dest.push_back(static_cast<std::byte>(value >> 8));
+}
+
+// Archive path with a leading separator and no empty components
+std::string archivePath(std::string_view path) {
+  std::string out;
+  size_t start = 0;
+  while (start < path.size()) {
+    size_t end = path.find_first_of("/\\", start);
+    if (end == std::string_view::npos) {
+      end = path.size();
+    }
+    if (end > start) {
+      out += '\\';
+      out += path.substr(start, end - start);
+    }
+    start = end + 1;
+  }
+  return out;
+}
+
+std::string upper(std::string_view text) {
+  std::string out(text);
+  for (auto &c : out) {
+    c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+  }
+  return out;
+}
+
+// Folder tree built from the entry paths. Children are keyed by upper-cased
+// name so folders differing only in case are merged, as the game would.
+struct treeNode {
+  std::string name;
+  uint32_t entry{UINT32_MAX}; // Index into entries, or UINT32_MAX for folders
+  std::map<std::string, std::unique_ptr<treeNode>> children;
+};
+
+} // namespace
+
+DatWriter::DatWriter(std::ostream &out, int32_t signature, bool withCRCs)
+    : out(out), sig(signature), withCRCs(withCRCs) {
+  // Header is patched in finish()
+  out.write("\0\0\0\0\0\0\0\0", 8);
+}
+
+void DatWriter::pad(uint64_t alignment) {
+  static const char zeroes[blockAlignment]{};
+  if (auto rest = position % alignment) {
+    out.write(zeroes, alignment - rest);
+    position += alignment - rest;
+  }
+}
+
+ttError DatWriter::add(std::string_view path, std::span<const std::byte> packed,
+                       uint32_t unpackedSize, uint32_t packedType) {
+  if (sig != -1) {
+    pad(blockAlignment);
+  }
+  uint64_t limit = sig == -1 ? UINT32_MAX : uint64_t{UINT32_MAX} << 8;
+  if (position + packed.size() > limit || entries.size() >= maxNames) {
+    return ttError::tooLarge;
+  }
+  entries.push_back({archivePath(path), position,
+                     static_cast<uint32_t>(packed.size()), unpackedSize,
+                     packedType});
+  out.write(reinterpret_cast<const char *>(packed.data()), packed.size());
+  position += packed.size();
+  return out ? ttError::none : ttError::writeFailed;
+}
+
+ttError DatWriter::finish(std::string *detail) {
+  // File info order: sorted by path hash when there's a CRC table, so the
+  // table itself is sorted
+  std::vector<uint32_t> order(entries.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::vector<uint32_t> hashes;
+  if (withCRCs) {
+    hashes.reserve(entries.size());
+    for (auto &e : entries) {
+      hashes.push_back(pathHash(e.path));
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](uint32_t a, uint32_t b) { return hashes[a] < hashes[b]; });
+    for (size_t i = 1; i < order.size(); ++i) {
+      if (hashes[order[i]] == hashes[order[i - 1]]) {
+        return fail(ttError::crcMismatch, detail,
+                    std::format("{} and {} have the same hash",
+                                entries[order[i - 1]].path, entries[order[i]].path));
+      }
+    }
+  }
+  std::vector<uint32_t> fileIndex(entries.size());
+  for (uint32_t i = 0; i < order.size(); ++i) {
+    fileIndex[order[i]] = i;
+  }
+
+  treeNode root;
+  for (uint32_t i = 0; i < entries.size(); ++i) {
+    treeNode *node = &root;
+    std::string_view rest = std::string_view(entries[i].path).substr(1);
+    while (true) {
+      auto end = rest.find('\\');
+      auto name = rest.substr(0, end);
+      auto &child = node->children[upper(name)];
+      if (end == std::string_view::npos) {
+        if (child) {
+          return fail(ttError::badNameTree, detail,
+                      std::format("Duplicate path {}", entries[i].path));
+        }
+        child = std::make_unique<treeNode>();
+        child->name = name;
+        child->entry = i;
+        break;
+      }
+      if (!child) {
+        child = std::make_unique<treeNode>();
+        child->name = name;
+      } else if (child->entry != UINT32_MAX) {
+        return fail(ttError::badNameTree, detail,
+                    std::format("{} is both a file and a folder", entries[i].path));
+      }
+      node = child.get();
+      rest = rest.substr(end + 1);
+    }
+  }
+
+  // Name table: each folder is followed by its contents, and every item but
+  // the first in a folder points back at its previous sibling
+  struct nameItem {
+    int16_t readType;
+    int16_t pathType;
+    uint32_t nameOffset;
+  };
+  std::vector<nameItem> names;
+  std::vector<std::byte> nameData;
+  std::unordered_map<std::string_view, uint32_t> nameOffsets;
+  auto addName = [&](std::string_view name) {
+    auto [found, added] =
+        nameOffsets.try_emplace(name, static_cast<uint32_t>(nameData.size()));
+    if (added) {
+      auto bytes = std::as_bytes(std::span(name.data(), name.size()));
+      nameData.insert(nameData.end(), bytes.begin(), bytes.end());
+      nameData.push_back(std::byte{0});
+    }
+    return found->second;
+  };
+  auto emit = [&](auto &self, const treeNode &folder) -> void {
+    int16_t previous = 0;
+    for (auto &[key, child] : folder.children) {
+      auto item = static_cast<int16_t>(names.size());
+      if (child->entry != UINT32_MAX) {
+        names.push_back({static_cast<int16_t>(-static_cast<int32_t>(fileIndex[child->entry])),
+                         previous, addName(child->name)});
+      } else {
+        names.push_back({0, previous, addName(child->name)});
+        self(self, *child);
+        names[item].readType = static_cast<int16_t>(names.size() - 1);
+      }
+      previous = item;
+    }
+  };
+  size_t folders = 0;
+  auto countFolders = [&](auto &self, const treeNode &folder) -> void {
+    for (auto &[key, child] : folder.children) {
+      if (child->entry == UINT32_MAX) {
+        folders++;
+        self(self, *child);
+      }
+    }
+  };
+  countFolders(countFolders, root);
+  if (1 + folders + entries.size() > maxNames) {
+    return fail(ttError::tooLarge, detail,
+                std::format("{} names don't fit in the name table",
+                            1 + folders + entries.size()));
+  }
+  names.push_back({0, 0, addName("")});
+  emit(emit, root);
+  names[0].readType = static_cast<int16_t>(std::max<size_t>(names.size() - 1, 1));
+
+  // Tables
+  if (sig != -1) {
+    pad(blockAlignment);
+  }
+  uint64_t infoOffset = position;
+  std::vector<std::byte> tables;
+  putUint32(tables, static_cast<uint32_t>(sig));
+  putUint32(tables, static_cast<uint32_t>(entries.size()));
+  for (auto i : order) {
+    auto &e = entries[i];
+    putUint32(tables, static_cast<uint32_t>(sig == -1 ? e.offset : e.offset >> 8));
+    putUint32(tables, e.packedSize);
+    putUint32(tables, e.unpackedSize);
+    uint32_t extraBytes = sig == -1 ? 0 : e.offset & 0xFF;
+    putUint32(tables, (e.packedType & 0xFF) | extraBytes << 24);
+  }
+  putUint32(tables, static_cast<uint32_t>(names.size()));
+  for (auto &n : names) {
+    putUint16(tables, static_cast<uint16_t>(n.readType));
+    putUint16(tables, static_cast<uint16_t>(n.pathType));
+    putUint32(tables, n.nameOffset);
+  }
+  putUint32(tables, static_cast<uint32_t>(nameData.size()));
+  tables.insert(tables.end(), nameData.begin(), nameData.end());
+  if (withCRCs && !entries.empty()) {
+    for (auto i : order) {
+      putUint32(tables, hashes[i]);
+    }
+    putUint32(tables, 0);
+    putUint32(tables, 0);
+  }
+  if (infoOffset + tables.size() > (sig == -1 ? UINT32_MAX : uint64_t{UINT32_MAX} << 8)) {
+    return ttError::tooLarge;
+  }
+  out.write(reinterpret_cast<const char *>(tables.data()), tables.size());
+
+  std::vector<std::byte> header;
+  putUint32(header, sig == -1 ? static_cast<uint32_t>(infoOffset)
+                              : ~static_cast<uint32_t>(infoOffset >> 8) + 1);
+  putUint32(header, static_cast<uint32_t>(tables.size()));
+  out.seekp(0);
+  out.write(reinterpret_cast<const char *>(header.data()), header.size());
+  out.flush();
+  return out ? ttError::none : ttError::writeFailed;
+}
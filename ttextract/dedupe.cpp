@@ -0,0 +1,119 @@
+// dedupe.cpp : Find entries that share their data so each is written once.
+
+#include "ttextract.h"
+#include "include/datindex.h"
+#include "include/threadpool.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <tuple>
+#include <unordered_map>
+
+namespace {
+
+// Fast 64-bit hash of a payload, eight bytes per step. Only used to find
+// candidates, which are then compared byte for byte, so collisions cost time
+// but never correctness.
+uint64_t payloadHash(std::span<const std::byte> data) {
+  constexpr uint64_t prime = 0x9E3779B97F4A7C15;
+  uint64_t hash = data.size() * prime;
+  size_t i = 0;
+  for (; i + 8 <= data.size(); i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data.data() + i, sizeof(word));
+    hash = (hash ^ word) * prime;
+    hash ^= hash >> 29;
+  }
+  for (; i < data.size(); ++i) {
+    hash = (hash ^ static_cast<uint8_t>(data[i])) * prime;
+  }
+  return hash ^ (hash >> 32);
+}
+
+} // namespace
+
+dedupePlan planDedupe(const DatIndex &index, const std::vector<uint32_t> &pending,
+                      bool byContent, ThreadPool &pool) {
+  const auto &archive = index.archive();
+  // Position in pending of the entry each entry is a copy of; its own
+  // position if it's the first with its data
+  std::vector<size_t> leader(pending.size());
+  std::iota(leader.begin(), leader.end(), 0);
+  auto sizes = [&](size_t i) {
+    auto info = index.fileInfo(pending[i]);
+    return std::tuple(info.packedSize, info.unpackedSize, info.packedType);
+  };
+  auto offset = [&](size_t i) { return index.fileInfo(pending[i]).offset; };
+
+  // Entries pointing at the same bytes of the archive are the same file.
+  // Sorting by sizes first also brings content candidates together below.
+  std::vector<size_t> order(pending.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return std::tuple(sizes(a), offset(a), a) < std::tuple(sizes(b), offset(b), b);
+  });
+  for (size_t i = 1; i < order.size(); ++i) {
+    if (sizes(order[i]) == sizes(order[i - 1]) &&
+        offset(order[i]) == offset(order[i - 1])) {
+      leader[order[i]] = leader[order[i - 1]];
+    }
+  }
+
+  if (byContent) {
+    // Distinct payloads of the same sizes may still hold the same bytes at
+    // different offsets. Only runs of those get hashed.
+    std::vector<size_t> candidates;
+    for (size_t runStart = 0, runEnd; runStart < order.size(); runStart = runEnd) {
+      std::vector<size_t> run;
+      for (runEnd = runStart;
+           runEnd < order.size() && sizes(order[runStart]) == sizes(order[runEnd]);
+           ++runEnd) {
+        auto current = order[runEnd];
+        if (leader[current] == current && archive.inBounds(index.fileInfo(pending[current]))) {
+          run.push_back(current);
+        }
+      }
+      if (run.size() > 1) {
+        candidates.insert(candidates.end(), run.begin(), run.end());
+      }
+    }
+    std::vector<uint64_t> hashes(candidates.size());
+    pool.parallelFor(candidates.size(), [&](size_t i, unsigned) {
+      hashes[i] = payloadHash(archive.payload(index.fileInfo(pending[candidates[i]])));
+    });
+    std::unordered_map<uint64_t, std::vector<size_t>> buckets;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      auto current = candidates[i];
+      auto data = archive.payload(index.fileInfo(pending[current]));
+      auto &bucket = buckets[hashes[i]];
+      auto match = std::find_if(bucket.begin(), bucket.end(), [&](size_t other) {
+        auto otherData = archive.payload(index.fileInfo(pending[other]));
+        return sizes(current) == sizes(other) &&
+               std::memcmp(otherData.data(), data.data(), data.size()) == 0;
+      });
+      if (match == bucket.end()) {
+        bucket.push_back(current);
+      } else {
+        leader[current] = *match;
+      }
+    }
+  }
+
+  // Resolve chains so every copy names the entry that will actually be
+  // written, and keep the earliest entry of each group as that one
+  dedupePlan plan;
+  std::vector<size_t> first(pending.size(), SIZE_MAX);
+  for (size_t i = 0; i < pending.size(); ++i) {
+    size_t root = i;
+    while (leader[root] != root) {
+      root = leader[root];
+    }
+    if (first[root] == SIZE_MAX) {
+      first[root] = i;
+      plan.unique.push_back(pending[i]);
+    } else {
+      plan.copies.emplace_back(pending[i], pending[first[root]]);
+    }
+  }
+  return plan;
+}
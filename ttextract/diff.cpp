@@ -0,0 +1,172 @@
+// diff.cpp : Compare two archives by their tables of contents.
+
+#include "ttextract.h"
+#include "include/pathfilter.h"
+#include "include/threadpool.h"
+#include "include/ttarchive.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+enum class diffKind { ADDED, REMOVED, MOVED, RESIZED, CHANGED, UNCHANGED };
+constexpr size_t diffKindCount = 6;
+constexpr std::array<const char *, diffKindCount> diffKindNames{
+    "added", "removed", "moved", "resized", "changed", "unchanged"};
+
+struct diffRecord {
+  std::string path;
+  diffKind kind;
+  const archiveEntry *before; // nullptr if added
+  const archiveEntry *after;  // nullptr if removed
+};
+
+std::unique_ptr<Archive> openForDiff(std::string_view name) {
+  std::unique_ptr<Archive> archive;
+  std::string detail;
+  auto error = Archive::open(static_cast<std::string>(name), archive, &detail);
+  if (error != ttError::none) {
+    logError(std::format("{}: {}", name, detail.empty() ? describe(error) : detail));
+    throw 1;
+  }
+  return archive;
+}
+
+// Whether the tables alone say the entry differs, or might be the same.
+// Entries with the same sizes are only told apart by their data, whether
+// they moved or were patched in place.
+diffKind compareInfo(const datFileInfo &before, const datFileInfo &after) {
+  if (before.unpackedSize != after.unpackedSize) {
+    return diffKind::RESIZED;
+  }
+  if (before.packedSize != after.packedSize ||
+      before.packedType != after.packedType) {
+    return diffKind::CHANGED;
+  }
+  return before.offset == after.offset ? diffKind::UNCHANGED : diffKind::MOVED;
+}
+
+std::string describeRecord(const diffRecord &record) {
+  switch (record.kind) {
+  case diffKind::ADDED:
+    return std::format("0x{:X} bytes", record.after->info.unpackedSize);
+  case diffKind::REMOVED:
+    return std::format("0x{:X} bytes", record.before->info.unpackedSize);
+  case diffKind::MOVED:
+    return std::format("0x{:X} -> 0x{:X}", record.before->info.offset,
+                       record.after->info.offset);
+  case diffKind::RESIZED:
+    return std::format("0x{:X} -> 0x{:X} bytes", record.before->info.unpackedSize,
+                       record.after->info.unpackedSize);
+  case diffKind::CHANGED:
+    if (record.before->info.packedSize == record.after->info.packedSize) {
+      return "same size, different data";
+    }
+    return std::format("0x{:X} -> 0x{:X} bytes packed", record.before->info.packedSize,
+                       record.after->info.packedSize);
+  default:
+    return {};
+  }
+}
+
+} // namespace
+
+void handleDiff(const cmdlineArgs &args) {
+  auto before = openForDiff(args.fileName);
+  auto after = openForDiff(args.diffName);
+  auto filter = makeFilter(args);
+
+  // Pair entries up by path; find() goes through the FNV hash first
+  std::vector<diffRecord> records;
+  std::vector<bool> matched(before->entries().size());
+  for (auto &entry : after->entries()) {
+    auto path = after->path(entry);
+    if (!filter.empty() && !filter.matches(path)) {
+      continue;
+    }
+    auto *old = before->find(path);
+    if (!old) {
+      records.push_back({std::move(path), diffKind::ADDED, nullptr, &entry});
+      continue;
+    }
+    matched[old - before->entries().data()] = true;
+    records.push_back({std::move(path), compareInfo(old->info, entry.info), old, &entry});
+  }
+  for (size_t i = 0; i < matched.size(); ++i) {
+    auto &entry = before->entries()[i];
+    if (matched[i]) {
+      continue;
+    }
+    auto path = before->path(entry);
+    if (filter.empty() || filter.matches(path)) {
+      records.push_back({std::move(path), diffKind::REMOVED, &entry, nullptr});
+    }
+  }
+
+  // Entries the tables can't tell apart have their data compared, in
+  // parallel since that's the one part that reads more than the tables
+  std::vector<size_t> ambiguous;
+  for (size_t i = 0; i < records.size(); ++i) {
+    if (records[i].kind == diffKind::MOVED ||
+        records[i].kind == diffKind::UNCHANGED) {
+      ambiguous.push_back(i);
+    }
+  }
+  ThreadPool pool(args.jobs);
+  pool.parallelFor(ambiguous.size(), [&](size_t i, unsigned) {
+    auto &record = records[ambiguous[i]];
+    auto oldData = before->view().payload(record.before->info);
+    auto newData = after->view().payload(record.after->info);
+    bool same = oldData.size() == record.before->info.packedSize &&
+                newData.size() == oldData.size() &&
+                std::memcmp(oldData.data(), newData.data(), oldData.size()) == 0;
+    if (!same) {
+      record.kind = diffKind::CHANGED;
+    }
+  });
+
+  std::sort(records.begin(), records.end(),
+            [](const diffRecord &a, const diffRecord &b) { return a.path < b.path; });
+  std::array<size_t, diffKindCount> counts{};
+  std::string out;
+  if (args.isJson) {
+    out += "[";
+  }
+  bool first = true;
+  for (auto &record : records) {
+    counts[static_cast<size_t>(record.kind)]++;
+    if (record.kind == diffKind::UNCHANGED) {
+      continue;
+    }
+    auto name = diffKindNames[static_cast<size_t>(record.kind)];
+    if (args.isJson) {
+      out += std::format("{}\n  {{\"path\":\"{}\",\"change\":\"{}\"", first ? "" : ",",
+                         jsonEscape(record.path), name);
+      for (auto [key, entry] : {std::pair{"old", record.before}, std::pair{"new", record.after}}) {
+        if (entry) {
+          out += std::format(",\"{}\":{{\"offset\":{},\"packedSize\":{},\"unpackedSize\":{},"
+                             "\"packedType\":{}}}",
+                             key, entry->info.offset, entry->info.packedSize,
+                             entry->info.unpackedSize, entry->info.packedType);
+        }
+      }
+      out += '}';
+    } else {
+      out += std::format("{:<10}{}\t{}\n", name, record.path, describeRecord(record));
+    }
+    first = false;
+  }
+  if (args.isJson) {
+    out += "\n]\n";
+  } else {
+    out += std::format("{} added, {} removed, {} moved, {} resized, {} changed, {} unchanged\n",
+                       counts[0], counts[1], counts[2], counts[3], counts[4], counts[5]);
+  }
+  std::cout << out;
+}
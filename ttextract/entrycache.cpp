@@ -0,0 +1,138 @@
+// entrycache.cpp : Sharded LRU cache of decoded entries.
+
+#include "include/entrycache.h"
+#include <algorithm>
+
+EntryCache::EntryCache(size_t byteBudget, unsigned shardCount)
+    : shards(std::max(shardCount, 1u)),
+      shardBudget(byteBudget / std::max(shardCount, 1u)) {}
+
+ttError EntryCache::get(const Archive &archive, const archiveEntry &entry,
+                        entryData &out) {
+  const auto &info = entry.info;
+  // Stored entries cost nothing to "decode", so don't spend budget on them
+  if (info.packedSize == info.unpackedSize) {
+    if (!archive.view().inBounds(info)) {
+      return ttError::truncated;
+    }
+    out = {nullptr, archive.view().payload(info)};
+    return ttError::none;
+  }
+
+  key k{&archive, archive.datIndex().entries()[entry.item].fileIndex};
+  auto &s = shardFor(k);
+  std::promise<result> decoding;
+  uint64_t ticket;
+  {
+    std::unique_lock guard(s.lock);
+    if (auto found = s.lookup.find(k); found != s.lookup.end()) {
+      s.order.splice(s.order.begin(), s.order, found->second);
+      s.hits++;
+      out = {found->second->second, *found->second->second};
+      return ttError::none;
+    }
+    s.misses++;
+    if (auto pending = s.inFlight.find(k); pending != s.inFlight.end()) {
+      s.coalesced++;
+      auto future = pending->second.second;
+      guard.unlock();
+      auto [error, data] = future.get();
+      if (data) {
+        out = {data, *data};
+      }
+      return error;
+    }
+    ticket = s.nextTicket++;
+    s.inFlight.emplace(k, std::pair(ticket, decoding.get_future().share()));
+  }
+
+  // Only keep the result if the entry wasn't forgotten while decoding
+  auto finish = [&](const decoded &data) {
+    std::lock_guard guard(s.lock);
+    auto pending = s.inFlight.find(k);
+    if (pending == s.inFlight.end() || pending->second.first != ticket) {
+      return;
+    }
+    s.inFlight.erase(pending);
+    if (data) {
+      insert(s, k, data);
+    }
+  };
+  ttError error;
+  decoded data;
+  try {
+    auto buffer = std::make_shared<std::vector<std::byte>>(info.unpackedSize);
+    error = archive.read(entry, *buffer);
+    if (error == ttError::none) {
+      data = std::move(buffer);
+    }
+  } catch (...) {
+    // Waiting threads get the same exception, and the next caller retries
+    finish(nullptr);
+    decoding.set_exception(std::current_exception());
+    throw;
+  }
+  finish(data);
+  decoding.set_value({error, data});
+  if (data) {
+    out = {data, *data};
+  }
+  return error;
+}
+
+void EntryCache::insert(shard &s, const key &k, const decoded &data) {
+  if (data->size() > shardBudget) {
+    return;
+  }
+  while (s.bytes + data->size() > shardBudget) {
+    auto &oldest = s.order.back();
+    s.bytes -= oldest.second->size();
+    s.lookup.erase(oldest.first);
+    s.order.pop_back();
+    s.evictions++;
+  }
+  s.order.emplace_front(k, data);
+  s.lookup[k] = s.order.begin();
+  s.bytes += data->size();
+}
+
+void EntryCache::forget(const Archive &archive) {
+  for (auto &s : shards) {
+    std::lock_guard guard(s.lock);
+    std::erase_if(s.inFlight, [&](const auto &pending) {
+      return pending.first.archive == &archive;
+    });
+    for (auto it = s.order.begin(); it != s.order.end();) {
+      if (it->first.archive == &archive) {
+        s.bytes -= it->second->size();
+        s.lookup.erase(it->first);
+        it = s.order.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+}
+
+void EntryCache::clear() {
+  for (auto &s : shards) {
+    std::lock_guard guard(s.lock);
+    s.order.clear();
+    s.lookup.clear();
+    s.bytes = 0;
+  }
+}
+
+cacheStats EntryCache::stats() const {
+  cacheStats total{};
+  for (auto &s : shards) {
+    std::lock_guard guard(s.lock);
+    total.hits += s.hits;
+    total.misses += s.misses;
+    total.evictions += s.evictions;
+    total.coalesced += s.coalesced;
+    total.bytes += s.bytes;
+    total.entries += s.order.size();
+  }
+  return total;
+}
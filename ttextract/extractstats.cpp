@@ -0,0 +1,150 @@
+// extractstats.cpp : Timing and throughput counters for --stats.
+
+#include "include/extractstats.h"
+#include "include/datindex.h"
+#include "ttextract.h"
+#include <algorithm>
+#include <format>
+#include <functional>
+
+namespace {
+
+constexpr std::array<const char *, statPhaseCount> phaseNames{
+    "parse", "resolve", "validate", "decode", "mkdir", "write"};
+
+double seconds(int64_t nanos) { return nanos / 1e9; }
+
+} // namespace
+
+ExtractStats::ExtractStats(unsigned workers, size_t slowestCount)
+    : workers(std::max(workers, 1u)), slowestCount(slowestCount),
+      started(clock::now()) {}
+
+void ExtractStats::addTime(unsigned worker, statPhase phase,
+                           clock::duration elapsed) {
+  workers[worker].nanos[static_cast<size_t>(phase)] +=
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+void ExtractStats::addEntry(unsigned worker, uint32_t item,
+                            const datFileInfo &info, uint64_t bytesOut,
+                            clock::duration elapsed) {
+  auto &w = workers[worker];
+  w.entries++;
+  w.bytesIn += info.packedSize;
+  w.bytesOut += bytesOut;
+  auto &alg = w.algs[info.packedType & 0xFF];
+  alg.files++;
+  alg.packed += info.packedSize;
+  alg.unpacked += info.unpackedSize;
+  if (slowestCount == 0) {
+    return;
+  }
+  int64_t nanos =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+  if (w.slowest.size() < slowestCount) {
+    w.slowest.emplace_back(nanos, item);
+    std::push_heap(w.slowest.begin(), w.slowest.end(), std::greater<>());
+  } else if (nanos > w.slowest.front().first) {
+    std::pop_heap(w.slowest.begin(), w.slowest.end(), std::greater<>());
+    w.slowest.back() = {nanos, item};
+    std::push_heap(w.slowest.begin(), w.slowest.end(), std::greater<>());
+  }
+}
+
+void ExtractStats::print(std::ostream &out, const DatIndex &index,
+                         bool json) const {
+  double wall = std::chrono::duration<double>(clock::now() - started).count();
+  counters total;
+  for (auto &w : workers) {
+    for (size_t i = 0; i < statPhaseCount; ++i) {
+      total.nanos[i] += w.nanos[i];
+    }
+    total.entries += w.entries;
+    total.bytesIn += w.bytesIn;
+    total.bytesOut += w.bytesOut;
+    for (size_t i = 0; i < total.algs.size(); ++i) {
+      total.algs[i].files += w.algs[i].files;
+      total.algs[i].packed += w.algs[i].packed;
+      total.algs[i].unpacked += w.algs[i].unpacked;
+    }
+    total.slowest.insert(total.slowest.end(), w.slowest.begin(), w.slowest.end());
+  }
+  std::sort(total.slowest.begin(), total.slowest.end(), std::greater<>());
+  if (total.slowest.size() > slowestCount) {
+    total.slowest.resize(slowestCount);
+  }
+  auto ratio = [](const algCounters &alg) {
+    return alg.packed ? static_cast<double>(alg.unpacked) / alg.packed : 0.0;
+  };
+
+  std::string text;
+  if (json) {
+    text += std::format("{{\"wallSeconds\":{:.6f},\"workers\":{},\"phases\":{{",
+                        wall, workers.size());
+    for (size_t i = 0; i < statPhaseCount; ++i) {
+      text += std::format("{}\"{}\":{:.6f}", i ? "," : "", phaseNames[i],
+                          seconds(total.nanos[i]));
+    }
+    text += std::format("}},\"entries\":{},\"bytesIn\":{},\"bytesOut\":{},"
+                        "\"algorithms\":[",
+                        total.entries, total.bytesIn, total.bytesOut);
+    bool first = true;
+    for (size_t i = 0; i < total.algs.size(); ++i) {
+      auto &alg = total.algs[i];
+      if (alg.files) {
+        text += std::format("{}{{\"alg\":\"{}\",\"packedType\":{},\"files\":{},"
+                            "\"packed\":{},\"unpacked\":{},\"ratio\":{:.3f}}}",
+                            first ? "" : ",", nameOfAlg(static_cast<int>(i)), i,
+                            alg.files, alg.packed, alg.unpacked, ratio(alg));
+        first = false;
+      }
+    }
+    text += "],\"slowest\":[";
+    for (size_t i = 0; i < total.slowest.size(); ++i) {
+      auto [nanos, item] = total.slowest[i];
+      text += std::format("{}{{\"path\":\"{}\",\"seconds\":{:.6f},"
+                          "\"unpackedSize\":{}}}",
+                          i ? "," : "", jsonEscape(index.path(item)),
+                          seconds(nanos), index.fileInfo(item).unpackedSize);
+    }
+    text += "]}\n";
+    out << text;
+    return;
+  }
+
+  text += std::format("\nStatistics ({} workers, {:.3f} s wall time)\n",
+                      workers.size(), wall);
+  text += "Phase   \tSeconds \tMB/s out\n";
+  for (size_t i = 0; i < statPhaseCount; ++i) {
+    double s = seconds(total.nanos[i]);
+    text += std::format("{:<8}\t{:<8.3f}\t", phaseNames[i], s);
+    bool moves = i == static_cast<size_t>(statPhase::DECODE) ||
+                 i == static_cast<size_t>(statPhase::WRITE);
+    text += moves && s > 0
+                ? std::format("{:.1f}\n", total.bytesOut / s / 1e6)
+                : "-\n";
+  }
+  text += std::format("{} entries, 0x{:X} bytes in, 0x{:X} bytes out, "
+                      "{:.1f} MB/s and {:.0f} entries/s overall\n",
+                      total.entries, total.bytesIn, total.bytesOut,
+                      wall > 0 ? total.bytesOut / wall / 1e6 : 0.0,
+                      wall > 0 ? total.entries / wall : 0.0);
+  text += "Alg \tFiles   \tPacked  \tUnpacked\tRatio\n";
+  for (size_t i = 0; i < total.algs.size(); ++i) {
+    auto &alg = total.algs[i];
+    if (alg.files) {
+      text += std::format("{}\t{:<8}\t{:<8X}\t{:<8X}\t{:.2f}\n",
+                          nameOfAlg(static_cast<int>(i)), alg.files, alg.packed,
+                          alg.unpacked, ratio(alg));
+    }
+  }
+  if (!total.slowest.empty()) {
+    text += "Slowest entries:\n";
+    for (auto [nanos, item] : total.slowest) {
+      text += std::format("  {:.3f} ms\t{:<8X}\t{}\n", nanos / 1e6,
+                          index.fileInfo(item).unpackedSize, index.path(item));
+    }
+  }
+  out << text;
+}
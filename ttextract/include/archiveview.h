@@ -0,0 +1,134 @@
+#ifndef ARCHIVEVIEW_H
+#define ARCHIVEVIEW_H
+
+#include "tterror.h"
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+/*
+File info table items are 16 bytes long.
+
+4 bytes = absolute offset of data
+    Signature other than -1 shifts left 8 bits
+4 bytes = size of file (archived)
+4 bytes = size of file (uncompressed)
+1 byte  = packed type
+2 bytes = unknown??
+1 byte  = byte offset from the given offset
+*/
+struct datFileInfo {
+    uint64_t offset;
+    uint32_t packedSize;
+    uint32_t unpackedSize;
+    uint32_t packedType;
+};
+
+/*
+Name info table items are 8 bytes long.
+
+First value is signed 16 bit.
+    If positive, read folder name. Value is index for last item in folder.
+    If negative or zero, read file name. Value is 2s complement of file ID.
+
+Second value is signed 16 bit.
+    If positive, use previous file path. Value is index of previous item
+written in directory If zero, do not use previous file path. Write item to
+current directory.
+
+Third value is relative 32-bit offset to read name from. This is added to the
+name data offset.
+*/
+struct datNameInfo {
+    int16_t readType;
+    int16_t pathType;
+    uint32_t nameOffset;
+};
+
+// Zero-copy view over the tables of a .DAT archive held in memory (usually a
+// MappedFile). The archive must outlive the view. All accessors are const and
+// safe to call from several threads.
+//
+// PC archives store their tables little endian, console ones big endian; the
+// byte order is detected from the header and every table is decoded by code
+// specialized for it.
+class ArchiveView {
+public:
+    // Validate the header and table layout of archive and point the view at
+    // it. On failure, returns the problem and describes it in detail.
+    [[nodiscard]] ttError parse(std::span<const std::byte> archive,
+        std::string* detail = nullptr);
+
+    [[nodiscard]] int32_t signature() const { return sig; }
+    [[nodiscard]] std::endian endianness() const { return order; }
+    [[nodiscard]] uint32_t numFiles() const { return fileCount; }
+    [[nodiscard]] uint32_t numNames() const { return nameCount; }
+    [[nodiscard]] bool hasCRCs() const { return !crcTable.empty(); }
+
+    // Absolute offsets of each table, for diagnostics
+    [[nodiscard]] size_t fileInfoOffset() const { return tableOffset(fileInfoTable); }
+    [[nodiscard]] size_t fileInfoSize() const { return infoSize; }
+    [[nodiscard]] size_t nameInfoOffset() const { return tableOffset(nameInfoTable); }
+    [[nodiscard]] size_t nameDataOffset() const { return tableOffset(nameData); }
+    [[nodiscard]] size_t nameCRCOffset() const { return tableOffset(nameData) + nameData.size(); }
+
+    [[nodiscard]] datFileInfo fileInfo(uint32_t index) const;
+    [[nodiscard]] datNameInfo nameInfo(uint32_t index) const;
+    // Records first to first + out.size() - 1 decoded into out, swapping the
+    // table a block at a time rather than field by field. Caller checks the
+    // range against numFiles() or numNames().
+    void fileInfos(uint32_t first, std::span<datFileInfo> out) const;
+    void nameInfos(uint32_t first, std::span<datNameInfo> out) const;
+    [[nodiscard]] uint32_t crc(uint32_t index) const;
+    // The whole CRC table (numFiles() values if hasCRCs()) decoded into out
+    // in one pass.
+    void crcs(std::span<uint32_t> out) const;
+
+    // NUL-terminated name at the given offset into the name data, or an empty
+    // view if the offset is out of range.
+    [[nodiscard]] std::string_view name(uint32_t nameOffset) const;
+    // Whether the name at the given offset is NUL-terminated within the name
+    // data, rather than cut short by the end of the table.
+    [[nodiscard]] bool nameInBounds(uint32_t nameOffset) const;
+
+    // Whether the stored bytes of an entry lie within the archive
+    [[nodiscard]] bool inBounds(const datFileInfo& info) const {
+        return info.offset <= archive.size() && info.packedSize <= archive.size() - info.offset;
+    }
+    // Stored bytes of an entry; empty unless inBounds(info).
+    [[nodiscard]] std::span<const std::byte> payload(const datFileInfo& info) const;
+
+    [[nodiscard]] std::span<const std::byte> bytes() const { return archive; }
+
+private:
+    template <std::endian endianness>
+    [[nodiscard]] ttError parseTables(std::string* detail);
+    template <std::endian endianness>
+    void decodeFileInfos(uint32_t first, std::span<datFileInfo> out) const;
+    template <std::endian endianness>
+    void decodeNameInfos(uint32_t first, std::span<datNameInfo> out) const;
+    // Records from their table's 32 bit words, already in native order
+    [[nodiscard]] datFileInfo unpackFileInfo(const uint32_t* words) const;
+    template <std::endian endianness>
+    [[nodiscard]] static datNameInfo unpackNameInfo(const uint32_t* words);
+
+    [[nodiscard]] size_t tableOffset(std::span<const std::byte> table) const {
+        return static_cast<size_t>(table.data() - archive.data());
+    }
+
+    std::span<const std::byte> archive;
+    std::span<const std::byte> fileInfoTable;
+    std::span<const std::byte> nameInfoTable;
+    std::span<const std::byte> nameData;
+    std::span<const std::byte> crcTable;
+    int32_t sig{ 0 };
+    std::endian order{ std::endian::little };
+    uint32_t fileCount{ 0 };
+    uint32_t nameCount{ 0 };
+    size_t infoSize{ 0 };
+};
+
+#endif // ARCHIVEVIEW_H
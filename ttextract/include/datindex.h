@@ -0,0 +1,91 @@
+#ifndef DATINDEX_H
+#define DATINDEX_H
+
+#include "archiveview.h"
+#include "pathfilter.h"
+#include "tterror.h"
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Via http://www.isthe.com/chongo/tech/comp/fnv/
+constexpr unsigned int FNV_BASIS = 2166136261;
+// constexpr unsigned int FNV_PRIME = 16777619;
+constexpr unsigned int FNV_PRIME = 1677619;
+
+// FNV hash of an archive path as stored in the CRC table: case-insensitive,
+// without the leading separator.
+[[nodiscard]] uint32_t pathHash(std::string_view path);
+
+// Continue an FNV path hash over more characters, so a folder's hash can be
+// extended by each of its children instead of rehashing the whole path.
+[[nodiscard]] uint32_t pathHashAppend(uint32_t crc, std::string_view text);
+
+// One item of the name table. Paths are stored as a link to the item whose
+// path prefixes this one plus this item's own name, so the whole tree costs a
+// few words per item.
+struct datIndexEntry {
+    static constexpr uint32_t noParent = UINT32_MAX;
+    static constexpr uint32_t noFile = UINT32_MAX;
+    static constexpr uint32_t filteredOut = UINT32_MAX - 1;
+
+    uint32_t parent;     // Item holding the enclosing path, or noParent
+    uint32_t nameOffset; // Offset of this item's name in the name data
+    uint32_t fileIndex;  // Index into the file info table, noFile for folders
+                         // or filteredOut for files rejected by the filter
+};
+
+// Flat table of every item in a .DAT archive, resolved from the name tree in
+// one pass without touching any file data. Full paths are only built on
+// request. The ArchiveView (and its archive) must outlive the index.
+class DatIndex {
+public:
+    // Resolve the name tree of archive. Fails if the tree is inconsistent or
+    // a name doesn't match the CRC table, describing the problem in detail.
+    // With a filter, only selected files are resolved and listed in files();
+    // folders that can't contain a selected file are pruned along with
+    // everything below them.
+    [[nodiscard]] ttError build(const ArchiveView& archive,
+        const PathFilter* filter = nullptr, std::string* detail = nullptr);
+
+    // Check everything extraction will rely on before any of it starts: the
+    // data of every selected file lies within the archive, and every name is
+    // terminated inside the name data and safe to use as one path component
+    // (not empty for files, no separators, no "." or ".."). Fails on the
+    // first problem, describing it in detail.
+    [[nodiscard]] ttError validate(std::string* detail = nullptr) const;
+
+    [[nodiscard]] const ArchiveView& archive() const { return *view; }
+    [[nodiscard]] const std::vector<datIndexEntry>& entries() const { return items; }
+    // Indices into entries() of every (selected) file, in name table order
+    [[nodiscard]] const std::vector<uint32_t>& files() const { return fileItems; }
+
+    [[nodiscard]] bool isFolder(uint32_t item) const {
+        return items[item].fileIndex == datIndexEntry::noFile;
+    }
+    [[nodiscard]] std::string_view name(uint32_t item) const {
+        return view->name(items[item].nameOffset);
+    }
+    [[nodiscard]] datFileInfo fileInfo(uint32_t item) const {
+        return view->fileInfo(items[item].fileIndex);
+    }
+
+    // Archive path of an item, e.g. "\LEVELS\CITY\CITY.GSC", appended to out.
+    void appendPath(uint32_t item, std::string& out) const;
+    [[nodiscard]] std::string path(uint32_t item) const;
+
+    // Where an item is extracted to under outDir, using the native separator.
+    [[nodiscard]] std::filesystem::path outputPath(
+        const std::filesystem::path& outDir, uint32_t item) const;
+
+private:
+    // Items from the root down to item, reusing chain's storage
+    void ancestry(uint32_t item, std::vector<uint32_t>& chain) const;
+
+    const ArchiveView* view{ nullptr };
+    std::vector<datIndexEntry> items;
+    std::vector<uint32_t> fileItems;
+};
+
+#endif // DATINDEX_H
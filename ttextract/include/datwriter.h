@@ -0,0 +1,48 @@
+#ifndef DATWRITER_H
+#define DATWRITER_H
+
+#include "tterror.h"
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Writes a .DAT archive in the layout ArchiveView reads: file data first,
+// then the file info, name tree, name data and optional CRC tables. Entry
+// data is streamed to out as it's added, in any order; the tables are built
+// and the header patched in finish(). out must be seekable.
+class DatWriter {
+public:
+    DatWriter(std::ostream& out, int32_t signature, bool withCRCs = true);
+
+    // Append an entry. path is its archive path; '/' and '\' both separate
+    // folders and a leading separator is optional. packed holds the stored
+    // bytes, packedType 2 for LZ2K or 0 for stored.
+    [[nodiscard]] ttError add(std::string_view path, std::span<const std::byte> packed,
+        uint32_t unpackedSize, uint32_t packedType);
+
+    // Write the tables. The writer can't be used afterwards.
+    [[nodiscard]] ttError finish(std::string* detail = nullptr);
+
+private:
+    struct entry {
+        std::string path; // "\DIR\FILE", as hashed for the CRC table
+        uint64_t offset;
+        uint32_t packedSize;
+        uint32_t unpackedSize;
+        uint32_t packedType;
+    };
+
+    void pad(uint64_t alignment);
+
+    std::ostream& out;
+    int32_t sig;
+    bool withCRCs;
+    uint64_t position{ 8 };
+    std::vector<entry> entries;
+};
+
+#endif // DATWRITER_H
@@ -0,0 +1,99 @@
+#ifndef ENTRYCACHE_H
+#define ENTRYCACHE_H
+
+#include "ttarchive.h"
+#include "tterror.h"
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct cacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    // Misses that waited for another thread's decode of the same entry
+    uint64_t coalesced;
+    size_t bytes;
+    size_t entries;
+};
+
+// Byte-budgeted LRU cache of decoded LZ2K entries for long-running users of
+// Archive, keyed by (archive, file index). The budget is split over shards,
+// each with its own lock, so threads reading different entries rarely
+// contend. Concurrent misses on the same entry are coalesced: one thread
+// decodes while the others wait for its result.
+//
+// Usually attached with Archive::useCache() and read through
+// Archive::read(entry, entryData&); one cache can serve many archives.
+class EntryCache {
+public:
+    explicit EntryCache(size_t byteBudget, unsigned shardCount = 16);
+    EntryCache(const EntryCache&) = delete;
+    EntryCache& operator=(const EntryCache&) = delete;
+
+    // Decoded bytes of entry, decoding through archive on a miss. Entries
+    // larger than a shard's budget are decoded but not kept.
+    [[nodiscard]] ttError get(const Archive& archive, const archiveEntry& entry,
+        entryData& out);
+
+    // Drop every cached entry of archive, e.g. before closing it. Decodes of
+    // its entries still running finish for their callers, but their results
+    // aren't kept. An Archive using the cache does this when destroyed.
+    void forget(const Archive& archive);
+    void clear();
+
+    [[nodiscard]] cacheStats stats() const;
+
+private:
+    struct key {
+        const Archive* archive;
+        uint32_t fileIndex;
+        bool operator==(const key&) const = default;
+    };
+    struct keyHash {
+        size_t operator()(const key& k) const {
+            return std::hash<const void*>()(k.archive) ^ (size_t{ k.fileIndex } * 0x9E3779B97F4A7C15ull);
+        }
+    };
+    using decoded = std::shared_ptr<const std::vector<std::byte>>;
+    using result = std::pair<ttError, decoded>;
+
+    struct shard {
+        mutable std::mutex lock;
+        // Most recently used first
+        std::list<std::pair<key, decoded>> order;
+        std::unordered_map<key, decltype(order)::iterator, keyHash> lookup;
+        // Decodes in progress, each with the ticket of the thread running it,
+        // so a decode whose entry was forgotten meanwhile isn't kept
+        std::unordered_map<key, std::pair<uint64_t, std::shared_future<result>>, keyHash> inFlight;
+        uint64_t nextTicket{ 0 };
+        size_t bytes{ 0 };
+        uint64_t hits{ 0 };
+        uint64_t misses{ 0 };
+        uint64_t evictions{ 0 };
+        uint64_t coalesced{ 0 };
+    };
+
+    // The maps bucket keys by the low bits of keyHash, so the shard is picked
+    // from the high bits of a remix; otherwise every key of a shard would
+    // share its low bits and use a fraction of the buckets
+    shard& shardFor(const key& k) {
+        uint64_t h = keyHash()(k);
+        h = (h ^ (h >> 33)) * 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        return shards[static_cast<size_t>(h >> 32) % shards.size()];
+    }
+    void insert(shard& s, const key& k, const decoded& data);
+
+    std::vector<shard> shards;
+    size_t shardBudget;
+};
+
+#endif // ENTRYCACHE_H
@@ -0,0 +1,84 @@
+#ifndef EXTRACTSTATS_H
+#define EXTRACTSTATS_H
+
+#include "archiveview.h"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+class DatIndex;
+
+// Where extraction time goes, for --stats. VALIDATE is the whole-archive
+// check done before anything is written.
+enum class statPhase { PARSE, RESOLVE, VALIDATE, DECODE, MKDIR, WRITE };
+constexpr size_t statPhaseCount = 6;
+
+// Per-phase timings, byte counts, compression ratio per packed type and the
+// slowest entries of an extraction. Each worker accumulates into its own
+// cache line with no locking, so the cost is a couple of clock reads per
+// phase per entry.
+class ExtractStats {
+public:
+    using clock = std::chrono::steady_clock;
+
+    // Adds elapsed time to a phase when it goes out of scope. Does nothing
+    // without stats.
+    class timer {
+    public:
+        timer(ExtractStats* stats, unsigned worker, statPhase phase)
+            : stats(stats), worker(worker), phase(phase),
+              start(stats ? clock::now() : clock::time_point()) {}
+        timer(const timer&) = delete;
+        timer& operator=(const timer&) = delete;
+        ~timer() {
+            if (stats) {
+                stats->addTime(worker, phase, clock::now() - start);
+            }
+        }
+
+    private:
+        ExtractStats* stats;
+        unsigned worker;
+        statPhase phase;
+        clock::time_point start;
+    };
+
+    ExtractStats(unsigned workers, size_t slowestCount);
+
+    void addTime(unsigned worker, statPhase phase, clock::duration elapsed);
+    // Leave time spent waiting on other work out of the wall time, e.g. while
+    // earlier archives of a batch extract
+    void skipWait(clock::duration waited) { started += waited; }
+    // Account a finished entry that produced bytesOut bytes in elapsed time
+    void addEntry(unsigned worker, uint32_t item, const datFileInfo& info,
+        uint64_t bytesOut, clock::duration elapsed);
+
+    // Summary table, or a JSON object
+    void print(std::ostream& out, const DatIndex& index, bool json) const;
+
+private:
+    struct algCounters {
+        uint64_t files;
+        uint64_t packed;
+        uint64_t unpacked;
+    };
+    struct alignas(64) counters {
+        std::array<int64_t, statPhaseCount> nanos{};
+        uint64_t entries{ 0 };
+        uint64_t bytesIn{ 0 };
+        uint64_t bytesOut{ 0 };
+        std::array<algCounters, 256> algs{};
+        // Min-heap of (nanoseconds, item), at most slowestCount long
+        std::vector<std::pair<int64_t, uint32_t>> slowest;
+    };
+
+    std::vector<counters> workers;
+    size_t slowestCount;
+    clock::time_point started;
+};
+
+#endif // EXTRACTSTATS_H
@@ -1,8 +1,14 @@
 #ifndef FILEREADING_H
 #define FILEREADING_H
 
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <istream>
+#include <span>
 
 using ENDIAN = std::endian;
 
@@ -14,6 +20,36 @@ using ENDIAN = std::endian;
     return (data >> 8) | (data << 8);
 }
 
+// Reverse the byte order of a 16 or 32 bit integer. std::byteswap where the
+// standard library has it, otherwise the shifts above, which compilers also
+// reduce to a single instruction.
+template <std::integral T>
+[[nodiscard]] inline T swapBytes(T data) {
+    static_assert(sizeof(T) == 2 || sizeof(T) == 4);
+#ifdef __cpp_lib_byteswap
+    return std::byteswap(data);
+#else
+    if constexpr (sizeof(T) == 2) {
+        return static_cast<T>(byteswap16(static_cast<unsigned short int>(data)));
+    }
+    else {
+        return static_cast<T>(byteswap32(static_cast<unsigned int>(data)));
+    }
+#endif
+}
+
+// Convert an integer stored in the given byte order to native order. Costs
+// nothing when the two match, since the order is known at compile time.
+template <ENDIAN endianness, std::integral T>
+[[nodiscard]] inline T fromEndian(T data) {
+    if constexpr (endianness == ENDIAN::native) {
+        return data;
+    }
+    else {
+        return swapBytes(data);
+    }
+}
+
 // Read 32 bit unsigned integer from file
 [[nodiscard]] inline unsigned int readUint32(std::ifstream& src,
     ENDIAN endianness) {
@@ -43,7 +79,7 @@ using ENDIAN = std::endian;
     if (ENDIAN::native != endianness) {
         return static_cast<int>(byteswap32(data));
     }
-    return data;
+    return static_cast<int>(data);
 }
 
 // Read 16 bit signed integer from file
@@ -57,4 +93,82 @@ using ENDIAN = std::endian;
     return data;
 }
 
+// Read 32 bit unsigned integer in a fixed byte order from a buffer. Caller
+// checks bounds.
+template <ENDIAN endianness>
+[[nodiscard]] inline unsigned int readUint32(std::span<const std::byte> src,
+    size_t offset) {
+    unsigned int data;
+    std::memcpy(&data, src.data() + offset, 4);
+    return fromEndian<endianness>(data);
+}
+
+// Read 16 bit unsigned integer in a fixed byte order from a buffer. Caller
+// checks bounds.
+template <ENDIAN endianness>
+[[nodiscard]] inline unsigned short int readUint16(std::span<const std::byte> src,
+    size_t offset) {
+    unsigned short int data;
+    std::memcpy(&data, src.data() + offset, 2);
+    return fromEndian<endianness>(data);
+}
+
+// Read 32 bit signed integer in a fixed byte order from a buffer. Caller
+// checks bounds.
+template <ENDIAN endianness>
+[[nodiscard]] inline int readInt32(std::span<const std::byte> src, size_t offset) {
+    return static_cast<int>(readUint32<endianness>(src, offset));
+}
+
+// Read 16 bit signed integer in a fixed byte order from a buffer. Caller
+// checks bounds.
+template <ENDIAN endianness>
+[[nodiscard]] inline short int readInt16(std::span<const std::byte> src,
+    size_t offset) {
+    return static_cast<short int>(readUint16<endianness>(src, offset));
+}
+
+// Read out.size() consecutive 32 bit unsigned integers from a buffer in one
+// go. The byte swap, if any, is a single loop over the whole table, which
+// compilers vectorize. Caller checks bounds.
+template <ENDIAN endianness>
+inline void readUint32s(std::span<const std::byte> src, size_t offset,
+    std::span<uint32_t> out) {
+    if (out.empty()) {
+        return;
+    }
+    std::memcpy(out.data(), src.data() + offset, out.size_bytes());
+    if constexpr (endianness != ENDIAN::native) {
+        for (auto& data : out) {
+            data = swapBytes(data);
+        }
+    }
+}
+
+// Read 32 bit unsigned integer from a buffer. Caller checks bounds.
+[[nodiscard]] inline unsigned int readUint32(std::span<const std::byte> src,
+    size_t offset, ENDIAN endianness) {
+    return endianness == ENDIAN::big ? readUint32<ENDIAN::big>(src, offset)
+                                     : readUint32<ENDIAN::little>(src, offset);
+}
+
+// Read 16 bit unsigned integer from a buffer. Caller checks bounds.
+[[nodiscard]] inline unsigned short int readUint16(std::span<const std::byte> src,
+    size_t offset, ENDIAN endianness) {
+    return endianness == ENDIAN::big ? readUint16<ENDIAN::big>(src, offset)
+                                     : readUint16<ENDIAN::little>(src, offset);
+}
+
+// Read 32 bit signed integer from a buffer. Caller checks bounds.
+[[nodiscard]] inline int readInt32(std::span<const std::byte> src,
+    size_t offset, ENDIAN endianness) {
+    return static_cast<int>(readUint32(src, offset, endianness));
+}
+
+// Read 16 bit signed integer from a buffer. Caller checks bounds.
+[[nodiscard]] inline short int readInt16(std::span<const std::byte> src,
+    size_t offset, ENDIAN endianness) {
+    return static_cast<short int>(readUint16(src, offset, endianness));
+}
+
 #endif // FILEREADING_H
\ No newline at end of file
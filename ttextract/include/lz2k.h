@@ -0,0 +1,16 @@
+#ifndef LZ2K_H
+#define LZ2K_H
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+// Largest amount of data stored in a single "LZ2K" chunk when compressing.
+constexpr size_t lz2kChunkSize = 0x40000;
+
+// Compress src into a sequence of "LZ2K" chunks (see unlz2k.h), appended to
+// dest. level trades speed for ratio by bounding the match search, 1-9.
+void lz2k(std::span<const std::byte> src, std::vector<std::byte>& dest,
+    int level = 5);
+
+#endif // LZ2K_H
@@ -0,0 +1,46 @@
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+
+// What an extracted file was produced from, and what it looked like on disk
+// afterwards.
+struct manifestRecord {
+    uint64_t offset;
+    uint32_t packedSize;
+    uint32_t unpackedSize;
+    uint32_t packedType;
+    uint32_t crc;        // FNV hash of the archive path
+    uint64_t outputSize;
+    int64_t mtime;       // Output file's last write time, in file clock ticks
+
+    bool operator==(const manifestRecord&) const = default;
+};
+
+// Record of a previous extraction kept in the output directory, so that
+// --incremental runs can skip entries whose table records haven't changed.
+class Manifest {
+public:
+    static constexpr const char* fileName = ".ttextract-manifest";
+
+    // Loads the manifest in outDir, if any. A manifest written with a
+    // different --raw setting is ignored.
+    void load(const std::filesystem::path& outDir, bool isRaw);
+    // Writes the manifest to outDir, replacing the old one atomically.
+    void save(const std::filesystem::path& outDir, bool isRaw) const;
+
+    [[nodiscard]] const manifestRecord* find(const std::string& path) const;
+    void update(const std::string& path, const manifestRecord& record);
+
+    // Whether outputFile still holds what record describes.
+    [[nodiscard]] static bool isCurrent(const manifestRecord& record,
+        const std::filesystem::path& outputFile);
+
+private:
+    std::unordered_map<std::string, manifestRecord> records;
+};
+
+#endif // MANIFEST_H
@@ -0,0 +1,53 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+// Read-only memory mapping of a whole file. Move-only; unmaps on destruction.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path);
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    [[nodiscard]] bool isOpen() const { return opened; }
+    [[nodiscard]] size_t size() const { return length; }
+    [[nodiscard]] std::span<const std::byte> bytes() const {
+        return { static_cast<const std::byte*>(address), length };
+    }
+    // Hint that [offset, offset + length) will be read soon so the OS starts
+    // reading it in the background. Clipped to the file; never blocks.
+    void prefetch(uint64_t offset, size_t length) const;
+    // Hint that the file will be read mostly front to back from now on, so
+    // the OS can read further ahead on its own.
+    void adviseSequential() const;
+
+    // The underlying file, for system calls that copy between files
+#ifdef _WIN32
+    [[nodiscard]] void* nativeHandle() const { return fileHandle; }
+#else
+    [[nodiscard]] int nativeHandle() const { return fd; }
+#endif
+
+private:
+    void close();
+
+    bool opened{ false };
+    const void* address{ nullptr };
+    size_t length{ 0 };
+#ifdef _WIN32
+    void* fileHandle{ nullptr };
+    void* mappingHandle{ nullptr };
+#else
+    int fd{ -1 };
+#endif
+};
+
+#endif // MAPPEDFILE_H
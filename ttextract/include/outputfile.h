@@ -0,0 +1,68 @@
+#ifndef OUTPUTFILE_H
+#define OUTPUTFILE_H
+
+#include "mappedfile.h"
+#include "tterror.h"
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+// Low-level output for extraction, going straight to the OS instead of
+// through iostreams.
+
+// Create every directory in dirs along with any missing parents. Each
+// directory is created once, parents first, so there's a single mkdir per
+// directory instead of an existence check per component per file.
+[[nodiscard]] ttError createDirectories(std::vector<std::filesystem::path> dirs,
+    std::string* detail = nullptr);
+
+// A file written piece by piece, for output that isn't in memory all at
+// once. Errors can surface at close(), so check it as well as write().
+class OutputFile {
+public:
+    OutputFile() = default;
+    ~OutputFile();
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+
+    // Replace the file at path with a new one, never writing through an
+    // existing hard link. A large expectedSize is reserved up front, as for
+    // writeWholeFile().
+    [[nodiscard]] ttError open(const std::filesystem::path& path, size_t expectedSize);
+    // Append data to the file
+    [[nodiscard]] ttError write(std::span<const std::byte> data);
+    [[nodiscard]] ttError close();
+
+private:
+#ifdef _WIN32
+    void* handle{ nullptr };
+#else
+    int fd{ -1 };
+#endif
+};
+
+// Replace the file at path with data. Larger files have their full size
+// reserved before writing so they can be laid out contiguously. The parent
+// directory must exist.
+[[nodiscard]] ttError writeWholeFile(const std::filesystem::path& path,
+    std::span<const std::byte> data);
+
+// Replace the file at path with size bytes of source starting at offset,
+// which must lie within the file. On Linux the copy stays in the kernel
+// (copy_file_range, or sendfile where that isn't supported); elsewhere, or if
+// neither works, the bytes are written from the mapping.
+[[nodiscard]] ttError copyToFile(const MappedFile& source, uint64_t offset,
+    size_t size, const std::filesystem::path& path);
+
+// Make path another name for the existing file target: a hard link where the
+// filesystem allows one, otherwise a copy through copyToFile(), which shares
+// extents on filesystems that support reflinks. Anything already at path is
+// replaced. target must be complete and closed; nothing may write to it
+// afterwards, since every output function replaces files instead of
+// truncating them.
+[[nodiscard]] ttError linkOrCopy(const std::filesystem::path& target,
+    const std::filesystem::path& path);
+
+#endif // OUTPUTFILE_H
@@ -0,0 +1,50 @@
+#ifndef PATHFILTER_H
+#define PATHFILTER_H
+
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Include/exclude patterns for archive paths. Patterns are globs matched
+// case-insensitively against the whole path, where '*' matches any run of
+// characters (separators included), '?' matches one character and '/' and
+// '\' are interchangeable. A leading separator is optional, and a leading
+// "*\" also matches at the top level, so "*\LEVELS\*.GSC" selects both
+// "\LEVELS\A.GSC" and "\MOD\LEVELS\B.GSC". Patterns starting with "re:" are
+// ECMAScript regular expressions over the path without its leading separator
+// instead.
+//
+// A file is selected if it matches any include (or there are none) and no
+// exclude. Folders can be tested up front so whole subtrees are skipped.
+class PathFilter {
+public:
+    void include(std::string_view pattern);
+    void exclude(std::string_view pattern);
+
+    [[nodiscard]] bool empty() const { return includes.empty() && excludes.empty(); }
+
+    // Whether a file with this path is selected
+    [[nodiscard]] bool matches(std::string_view path) const;
+
+    // False if no file below this folder can be selected
+    [[nodiscard]] bool mayMatchUnder(std::string_view folderPath) const;
+
+private:
+    struct pattern {
+        std::string glob;
+        bool isRegex{ false };
+        std::regex regex;
+    };
+
+    static pattern compile(std::string_view text);
+    static bool globMatch(const std::string& glob, std::string_view path);
+    // Whether the glob could match something starting with prefix; if
+    // everything starting with prefix matches, sets coversAll.
+    static bool globPrefix(const std::string& glob, std::string_view prefix, bool& coversAll);
+
+    std::vector<pattern> includes;
+    std::vector<pattern> excludes;
+};
+
+#endif // PATHFILTER_H
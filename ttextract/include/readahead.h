@@ -0,0 +1,55 @@
+#ifndef READAHEAD_H
+#define READAHEAD_H
+
+#include "mappedfile.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Byte range of a file one work item reads
+struct readRange {
+    uint64_t offset;
+    uint64_t size;
+};
+
+// Hands out work items in the order of the file data they read, to any
+// number of workers at once, and keeps a bounded window of the file ahead of
+// them prefetched. The workers' reads then move through the file front to
+// back in large sequential chunks instead of seeking between entries, which
+// is what spinning disks and network storage need.
+class ReadAheadQueue {
+public:
+    // Prefetch this far ahead of the furthest item handed out
+    static constexpr uint64_t defaultWindow = 0x4000000;
+
+    // ranges[i] is what item i reads; they needn't be sorted. The file must
+    // outlive the queue. Prefetching starts with the first item, before any
+    // worker asks for it.
+    ReadAheadQueue(const MappedFile& file, const std::vector<readRange>& ranges,
+        uint64_t window = defaultWindow);
+
+    // Take the next item in file order. Returns false once every item has been
+    // handed out (or after stop()).
+    [[nodiscard]] bool next(size_t& item);
+
+    // Hand out nothing more, e.g. after a worker failed
+    void stop() { nextIndex = order.size(); }
+
+private:
+    // Prefetch up to a window past the item at index in file order, if the
+    // window has run low
+    void topUp(size_t index);
+
+    const MappedFile& file;
+    uint64_t window;
+    std::vector<size_t> order;
+    // ranges in file order
+    std::vector<readRange> sorted;
+    std::atomic<size_t> nextIndex{ 0 };
+    std::mutex prefetchLock;
+    uint64_t prefetched{ 0 };
+};
+
+#endif // READAHEAD_H
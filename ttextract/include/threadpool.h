@@ -0,0 +1,64 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running index ranges with work stealing. Each
+// parallelFor call splits [0, count) evenly between the workers; a worker that
+// runs out steals the back half of the largest remaining range.
+class ThreadPool {
+public:
+    // Body of a parallelFor: item index and the worker running it, in
+    // [0, size()), so callers can keep per-worker scratch state.
+    using task = std::function<void(size_t index, unsigned worker)>;
+
+    // 0 threads means one per hardware thread.
+    explicit ThreadPool(unsigned threadCount);
+    // Number of workers a pool constructed with threadCount will have
+    [[nodiscard]] static unsigned workerCount(unsigned threadCount);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    [[nodiscard]] unsigned size() const { return static_cast<unsigned>(ranges.size()); }
+
+    // Run body for every index in [0, count) and wait for completion. If a call
+    // throws, the remaining items are abandoned and the first exception is
+    // rethrown here.
+    void parallelFor(size_t count, const task& body);
+
+private:
+    struct alignas(64) range {
+        std::mutex lock;
+        size_t next{ 0 };
+        size_t end{ 0 };
+    };
+
+    void workerLoop(unsigned worker);
+    void runItems(unsigned worker);
+    bool takeOwn(unsigned worker, size_t& index);
+    bool steal(unsigned worker, size_t& index);
+
+    std::vector<range> ranges;
+    std::vector<std::thread> threads;
+    std::mutex stateLock;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const task* job{ nullptr };
+    uint64_t generation{ 0 };
+    unsigned running{ 0 };
+    bool stopping{ false };
+    std::atomic<bool> cancelled{ false };
+    std::exception_ptr error;
+};
+
+#endif // THREADPOOL_H
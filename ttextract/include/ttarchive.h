@@ -0,0 +1,99 @@
+#ifndef TTARCHIVE_H
+#define TTARCHIVE_H
+
+#include "archiveview.h"
+#include "datindex.h"
+#include "mappedfile.h"
+#include "tterror.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class EntryCache;
+
+// A file in an Archive. Entries stay valid for the lifetime of the Archive.
+struct archiveEntry {
+    uint32_t item;   // Index into the name table (DatIndex::entries())
+    datFileInfo info;
+};
+
+// Decoded bytes of an entry. For stored entries bytes points straight into the
+// archive and holder is empty; otherwise holder keeps the decoded copy alive,
+// even after an EntryCache evicts it.
+struct entryData {
+    std::shared_ptr<const std::vector<std::byte>> holder;
+    std::span<const std::byte> bytes;
+};
+
+// Random-access reader for a .DAT archive, meant for embedding ttextract in
+// other tools. Opening maps the file and resolves the name tree once; entries
+// are then looked up by path and decoded on demand straight into memory the
+// caller provides. Nothing throws and nothing is logged, every failure is a
+// ttError. All members are const after open() and safe to call from any
+// number of threads at once.
+//
+//   std::unique_ptr<Archive> archive;
+//   if (Archive::open("GAME.DAT", archive) != ttError::none) ...
+//   if (auto* entry = archive->find("levels/city/city.gsc")) {
+//       std::vector<std::byte> data(entry->info.unpackedSize);
+//       auto error = archive->read(*entry, data);
+//   }
+class Archive {
+public:
+    // Map and index the archive at path. On failure archive is left empty
+    // and detail, if given, describes the problem.
+    [[nodiscard]] static ttError open(const std::string& path,
+        std::unique_ptr<Archive>& archive, std::string* detail = nullptr);
+    // Same, for an archive already in memory which must outlive the Archive.
+    [[nodiscard]] static ttError open(std::span<const std::byte> bytes,
+        std::unique_ptr<Archive>& archive, std::string* detail = nullptr);
+
+    ~Archive();
+    Archive(const Archive&) = delete;
+    Archive& operator=(const Archive&) = delete;
+
+    // Share decoded entries through cache, which must outlive the Archive
+    // (nullptr to stop). Call before reading from several threads.
+    void useCache(EntryCache* cache);
+
+    // Every file, in name table order
+    [[nodiscard]] const std::vector<archiveEntry>& entries() const { return files; }
+
+    // Entry with the given path, or nullptr. Matching is case-insensitive,
+    // '/' and '\' are interchangeable and the leading separator is optional.
+    [[nodiscard]] const archiveEntry* find(std::string_view path) const;
+
+    // Archive path of an entry, e.g. "\LEVELS\CITY\CITY.GSC"
+    [[nodiscard]] std::string path(const archiveEntry& entry) const {
+        return index.path(entry.item);
+    }
+
+    // Decode an entry into the first info.unpackedSize bytes of out.
+    [[nodiscard]] ttError read(const archiveEntry& entry, std::span<std::byte> out) const;
+    // Decoded bytes of an entry in memory the Archive manages: through the
+    // cache if there is one, so hot entries are decoded once, otherwise a
+    // fresh copy. Stored entries point into the archive either way.
+    [[nodiscard]] ttError read(const archiveEntry& entry, entryData& out) const;
+
+    [[nodiscard]] const ArchiveView& view() const { return archive; }
+    [[nodiscard]] const DatIndex& datIndex() const { return index; }
+
+private:
+    Archive() = default;
+    [[nodiscard]] ttError load(std::span<const std::byte> bytes, std::string* detail);
+
+    MappedFile file;
+    EntryCache* cache{ nullptr };
+    ArchiveView archive;
+    DatIndex index;
+    std::vector<archiveEntry> files;
+    // (pathHash, position in files), sorted for lookup by find()
+    std::vector<std::pair<uint32_t, uint32_t>> byHash;
+};
+
+#endif // TTARCHIVE_H
@@ -0,0 +1,64 @@
+#ifndef TTERROR_H
+#define TTERROR_H
+
+// Error codes reported by the archive parsing and reading layer. The command
+// line tool turns these into messages; library users get them directly.
+enum class ttError {
+    none,
+    cannotOpen,
+    unrecognizedFormat,
+    truncated,
+    sizeMismatch,
+    badSignature,
+    badTrailer,
+    badNameTree,
+    crcMismatch,
+    fileIndexOutOfRange,
+    notFound,
+    bufferTooSmall,
+    unknownPackedType,
+    corruptData,
+    tooLarge,
+    writeFailed,
+};
+
+[[nodiscard]] constexpr const char* describe(ttError error) {
+    switch (error) {
+        using enum ttError;
+    case none:
+        return "No error";
+    case cannotOpen:
+        return "Cannot open file";
+    case unrecognizedFormat:
+        return "Unrecognized archive type";
+    case truncated:
+        return "Archive is truncated";
+    case sizeMismatch:
+        return "Archive size doesn't match its header";
+    case badSignature:
+        return "Invalid file signature";
+    case badTrailer:
+        return "Unexpected data after the CRC table";
+    case badNameTree:
+        return "Inconsistent name table";
+    case crcMismatch:
+        return "Name doesn't correspond to a file";
+    case fileIndexOutOfRange:
+        return "File index out of range";
+    case notFound:
+        return "No such file in archive";
+    case bufferTooSmall:
+        return "Output buffer too small";
+    case unknownPackedType:
+        return "Unknown packed type";
+    case corruptData:
+        return "Compressed data is corrupt";
+    case tooLarge:
+        return "Too many files or too much data for a .DAT archive";
+    case writeFailed:
+        return "Error writing archive";
+    }
+    return "Unknown error";
+}
+
+#endif // TTERROR_H
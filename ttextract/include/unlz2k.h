@@ -1,15 +1,59 @@
 #ifndef UNLZ2K_H
 #define UNLZ2K_H
 
-#ifdef UNLZ2K_EXPORTS
-#define UNLZ2K_API __declspec(dllexport)
-#else
-#define UNLZ2K_API __declspec(dllimport)
-#endif
+#include <cstddef>
+#include <memory>
+#include <span>
 
-#include <fstream>
+// LZ2K is the LHA-style (LZ77 + static Huffman blocks, 8 KB window)
+// compression used by Traveller's Tales. Compressed entries are either a bare
+// bit stream or a sequence of chunks, each with a 12 byte header:
+//   4 bytes = "LZ2K"
+//   4 bytes = unpacked size of chunk
+//   4 bytes = packed size of chunk (excluding header)
 
-extern UNLZ2K_API size_t unlz2k(std::ifstream&, std::ofstream&);
-extern UNLZ2K_API size_t unlz2k(std::ifstream&, std::ofstream&, size_t, size_t);
+// Decompress src into dest, stopping once dest is full. Returns the number of
+// bytes written; anything short of dest.size() means the input is corrupt or
+// truncated. Never reads or writes outside the given spans.
+[[nodiscard]] size_t unlz2k(std::span<const std::byte> src,
+    std::span<std::byte> dest);
 
-#endif // UNLZ2K_H
\ No newline at end of file
+// Total unpacked size recorded in the chunk headers of src, or 0 if src is a
+// bare stream without headers.
+[[nodiscard]] size_t lz2kUnpackedSize(std::span<const std::byte> src);
+
+// Incremental decoder for entries too large to decode in one piece. Packed
+// input is queued with feed() and decoded output pulled with drain(). Memory
+// use is a fixed 32 KB output ring holding the 8 KB window, plus whatever
+// queued input hasn't been decoded yet, regardless of the entry's size. The
+// output is the same as unlz2k() gives for the whole input.
+class Lz2kStream {
+public:
+    // unpackedSize is the entry's total decoded size
+    explicit Lz2kStream(size_t unpackedSize);
+    ~Lz2kStream();
+    Lz2kStream(const Lz2kStream&) = delete;
+    Lz2kStream& operator=(const Lz2kStream&) = delete;
+
+    // Queue the next piece of packed input. Pass last with (or after) the
+    // final piece so the decoder can read up to the end of the input.
+    void feed(std::span<const std::byte> input, bool last = false);
+
+    // Decode into out as far as the queued input allows. Returns the number
+    // of bytes written; less than out.size() means more input is needed, or
+    // that the stream is finished or has failed.
+    [[nodiscard]] size_t drain(std::span<std::byte> out);
+
+    // drain() stopped because it ran out of queued input
+    [[nodiscard]] bool needsInput() const;
+    // All unpackedSize bytes have been drained
+    [[nodiscard]] bool finished() const;
+    // The input is corrupt or ended too early
+    [[nodiscard]] bool failed() const;
+
+private:
+    struct state;
+    std::unique_ptr<state> impl;
+};
+
+#endif // UNLZ2K_H
@@ -0,0 +1,83 @@
+// list.cpp : Print the contents of an archive from its tables alone.
+
+#include "ttextract.h"
+#include "include/datindex.h"
+#include <format>
+#include <iostream>
+#include <string>
+
+std::string jsonEscape(std::string_view text) {
+  std::string out;
+  out.reserve(text.size() + 2);
+  for (char c : text) {
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    case '\t':
+      out += "\\t";
+      break;
+    default:
+      auto byte = static_cast<unsigned char>(c);
+      // Names aren't necessarily UTF-8, so treat anything else as Latin-1
+      if (byte < 0x20 || byte >= 0x80) {
+        out += std::format("\\u{:04x}", byte);
+      } else {
+        out += c;
+      }
+    }
+  }
+  return out;
+}
+
+void listDAT(const DatIndex &index, const cmdlineArgs &args) {
+  // Built up in memory and written once; listings can run to 100k+ lines
+  std::string out;
+  std::string path;
+  uint64_t totalPacked = 0, totalUnpacked = 0;
+  if (args.isJson) {
+    const auto &archive = index.archive();
+    out += std::format("{{\"archive\":\"{}\",\"format\":\"DAT\",\"signature\":{},"
+                       "\"endian\":\"{}\",\"files\":[",
+                       jsonEscape(args.fileName), archive.signature(),
+                       archive.endianness() == std::endian::big ? "big" : "little");
+  } else {
+    out += "Offset  \tPacked  \tUnpacked\tAlg?\tFile\n";
+    out += std::string(100, '-') + '\n';
+  }
+  bool first = true;
+  for (auto item : index.files()) {
+    auto info = index.fileInfo(item);
+    path.clear();
+    index.appendPath(item, path);
+    totalPacked += info.packedSize;
+    totalUnpacked += info.unpackedSize;
+    if (args.isJson) {
+      out += std::format("{}\n{{\"path\":\"{}\",\"offset\":{},\"packedSize\":{},"
+                         "\"unpackedSize\":{},\"packedType\":{},\"alg\":\"{}\"}}",
+                         first ? "" : ",", jsonEscape(path), info.offset,
+                         info.packedSize, info.unpackedSize, info.packedType,
+                         nameOfAlg(info.packedType));
+      first = false;
+    } else {
+      out += std::format("{:0>8X}\t{:<8X}\t{:<8X}\t{}\t{}\n", info.offset,
+                         info.packedSize, info.unpackedSize,
+                         nameOfAlg(info.packedType), path);
+    }
+  }
+  if (args.isJson) {
+    out += std::format("\n],\"totalPacked\":{},\"totalUnpacked\":{}}}\n",
+                       totalPacked, totalUnpacked);
+  } else {
+    out += std::string(100, '-') + '\n';
+    out += std::format("{} files, 0x{:X} bytes packed, 0x{:X} bytes unpacked\n",
+                       index.files().size(), totalPacked, totalUnpacked);
+  }
+  std::cout << out;
+}
@@ -0,0 +1,414 @@
+// lz2k.cpp : LZ2K compressor, the inverse of unlz2k.cpp.
+//
+// Greedy LZ77 over an 8 KB window with hash chains, emitted as ar002-style
+// blocks of canonical Huffman codes limited to 16 bits.
+
+#include "include/lz2k.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+
+namespace {
+
+constexpr int DICBIT = 13;
+constexpr uint32_t DICSIZ = 1u << DICBIT;
+constexpr int MAXMATCH = 256;
+constexpr int THRESHOLD = 3;
+constexpr int NC = UINT8_MAX + MAXMATCH + 2 - THRESHOLD;
+constexpr int CBIT = 9;
+constexpr int CODE_BIT = 16;
+constexpr int NP = DICBIT + 1;
+constexpr int NT = CODE_BIT + 3;
+constexpr int PBIT = 4;
+constexpr int TBIT = 5;
+constexpr int NPT = NT;
+// Symbols per Huffman block; must fit the 16 bit block size field
+constexpr size_t blockTokens = 0x4000;
+
+constexpr int hashBits = 15;
+constexpr uint32_t noPos = UINT32_MAX;
+
+class bitWriter {
+public:
+  explicit bitWriter(std::vector<std::byte> &dest) : out(dest) {}
+
+  void put(int n, uint32_t bits) {
+    if (n == 0) {
+      return;
+    }
+    acc = (acc << n) | (bits & ((1u << n) - 1));
+    count += n;
+    while (count >= 8) {
+      count -= 8;
+      out.push_back(static_cast<std::byte>(acc >> count));
+    }
+  }
+
+  void flush() {
+    if (count > 0) {
+      out.push_back(static_cast<std::byte>(acc << (8 - count)));
+      count = 0;
+    }
+  }
+
+private:
+  std::vector<std::byte> &out;
+  uint64_t acc{0};
+  int count{0};
+};
+
+// Code lengths for a Huffman code over freq, limited to 16 bits. Returns the
+// number of symbols with a non-zero frequency; if that is less than two no
+// lengths are assigned.
+int makeLengths(const uint32_t *freq, int n, uint8_t *len) {
+  std::memset(len, 0, n);
+  std::vector<int> symbols;
+  for (int i = 0; i < n; ++i) {
+    if (freq[i]) {
+      symbols.push_back(i);
+    }
+  }
+  int used = static_cast<int>(symbols.size());
+  if (used < 2) {
+    return used;
+  }
+  // Plain Huffman tree to find depths
+  std::vector<uint64_t> weight;
+  std::vector<int> parent(2 * used, -1);
+  using node = std::pair<uint64_t, int>;
+  std::priority_queue<node, std::vector<node>, std::greater<node>> heap;
+  for (int i = 0; i < used; ++i) {
+    weight.push_back(freq[symbols[i]]);
+    heap.emplace(weight.back(), i);
+  }
+  while (heap.size() > 1) {
+    auto [w1, a] = heap.top();
+    heap.pop();
+    auto [w2, b] = heap.top();
+    heap.pop();
+    int id = static_cast<int>(weight.size());
+    weight.push_back(w1 + w2);
+    parent[a] = parent[b] = id;
+    heap.emplace(w1 + w2, id);
+  }
+  uint32_t lenCount[17]{};
+  for (int i = 0; i < used; ++i) {
+    int depth = 0;
+    for (int p = i; parent[p] != -1; p = parent[p]) {
+      depth++;
+    }
+    lenCount[std::min(depth, 16)]++;
+  }
+  // Restore the Kraft sum after clamping, as ar002's make_len does
+  uint32_t cum = 0;
+  for (int i = 16; i > 0; --i) {
+    cum += lenCount[i] << (16 - i);
+  }
+  while (cum != 1u << 16) {
+    lenCount[16]--;
+    for (int i = 15; i > 0; --i) {
+      if (lenCount[i]) {
+        lenCount[i]--;
+        lenCount[i + 1] += 2;
+        break;
+      }
+    }
+    cum--;
+  }
+  // Most frequent symbols get the shortest codes
+  std::stable_sort(symbols.begin(), symbols.end(),
+                   [&](int a, int b) { return freq[a] > freq[b]; });
+  auto it = symbols.begin();
+  for (int i = 1; i <= 16; ++i) {
+    for (uint32_t k = 0; k < lenCount[i]; ++k) {
+      len[*it++] = static_cast<uint8_t>(i);
+    }
+  }
+  return used;
+}
+
+// Canonical codes matching the decoder's table construction.
+void makeCodes(int n, const uint8_t *len, uint16_t *code) {
+  uint32_t count[17]{}, start[18]{};
+  for (int i = 0; i < n; ++i) {
+    count[len[i]]++;
+  }
+  for (int i = 1; i <= 16; ++i) {
+    start[i + 1] = (start[i] + count[i]) << 1;
+  }
+  for (int i = 0; i < n; ++i) {
+    code[i] = static_cast<uint16_t>(start[len[i]]++);
+  }
+}
+
+struct token {
+  uint16_t symbol;
+  uint16_t position; // match distance minus one
+};
+
+class encoder {
+public:
+  explicit encoder(std::vector<std::byte> &dest) : bits(dest) {}
+
+  void sendBlock(const std::vector<token> &tokens) {
+    uint32_t cFreq[NC]{}, pFreq[NP]{};
+    for (auto &t : tokens) {
+      cFreq[t.symbol]++;
+      if (t.symbol > UINT8_MAX) {
+        pFreq[positionBits(t.position)]++;
+      }
+    }
+    bits.put(16, static_cast<uint32_t>(tokens.size()));
+    int cUsed = makeLengths(cFreq, NC, cLen);
+    if (cUsed >= 2) {
+      makeCodes(NC, cLen, cCode);
+      uint32_t tFreq[NT]{};
+      countTFreq(tFreq);
+      int tUsed = makeLengths(tFreq, NT, ptLen);
+      if (tUsed >= 2) {
+        makeCodes(NT, ptLen, ptCode);
+        writePtLen(NT, TBIT, 3);
+      } else {
+        bits.put(TBIT, 0);
+        bits.put(TBIT, singleSymbol(tFreq, NT));
+      }
+      writeCLen();
+    } else {
+      bits.put(TBIT, 0);
+      bits.put(TBIT, 0);
+      bits.put(CBIT, 0);
+      bits.put(CBIT, singleSymbol(cFreq, NC));
+    }
+    int pUsed = makeLengths(pFreq, NP, ptLen);
+    if (pUsed >= 2) {
+      makeCodes(NP, ptLen, ptCode);
+      writePtLen(NP, PBIT, -1);
+    } else {
+      bits.put(PBIT, 0);
+      bits.put(PBIT, singleSymbol(pFreq, NP));
+    }
+    for (auto &t : tokens) {
+      bits.put(cLen[t.symbol], cCode[t.symbol]);
+      if (t.symbol > UINT8_MAX) {
+        int c = positionBits(t.position);
+        bits.put(ptLen[c], ptCode[c]);
+        if (c > 1) {
+          bits.put(c - 1, t.position);
+        }
+      }
+    }
+  }
+
+  void finish() { bits.flush(); }
+
+private:
+  static int positionBits(uint32_t position) {
+    int c = 0;
+    for (; position; position >>= 1) {
+      c++;
+    }
+    return c;
+  }
+
+  static uint32_t singleSymbol(const uint32_t *freq, int n) {
+    for (int i = 0; i < n; ++i) {
+      if (freq[i]) {
+        return i;
+      }
+    }
+    return 0;
+  }
+
+  int cLenCount() const {
+    int n = NC;
+    while (n > 0 && cLen[n - 1] == 0) {
+      n--;
+    }
+    return n;
+  }
+
+  void countTFreq(uint32_t *tFreq) const {
+    int n = cLenCount();
+    int i = 0;
+    while (i < n) {
+      int k = cLen[i++];
+      if (k == 0) {
+        int count = 1;
+        while (i < n && cLen[i] == 0) {
+          i++;
+          count++;
+        }
+        if (count <= 2) {
+          tFreq[0] += count;
+        } else if (count <= 18) {
+          tFreq[1]++;
+        } else if (count == 19) {
+          tFreq[0]++;
+          tFreq[1]++;
+        } else {
+          tFreq[2]++;
+        }
+      } else {
+        tFreq[k + 2]++;
+      }
+    }
+  }
+
+  void writePtLen(int n, int nbit, int iSpecial) {
+    while (n > 0 && ptLen[n - 1] == 0) {
+      n--;
+    }
+    bits.put(nbit, n);
+    int i = 0;
+    while (i < n) {
+      int k = ptLen[i++];
+      if (k <= 6) {
+        bits.put(3, k);
+      } else {
+        bits.put(k - 3, (1u << (k - 3)) - 2);
+      }
+      if (i == iSpecial) {
+        while (i < 6 && ptLen[i] == 0) {
+          i++;
+        }
+        bits.put(2, (i - 3) & 3);
+      }
+    }
+  }
+
+  void writeCLen() {
+    int n = cLenCount();
+    bits.put(CBIT, n);
+    int i = 0;
+    while (i < n) {
+      int k = cLen[i++];
+      if (k == 0) {
+        int count = 1;
+        while (i < n && cLen[i] == 0) {
+          i++;
+          count++;
+        }
+        if (count <= 2) {
+          for (int j = 0; j < count; ++j) {
+            bits.put(ptLen[0], ptCode[0]);
+          }
+        } else if (count <= 18) {
+          bits.put(ptLen[1], ptCode[1]);
+          bits.put(4, count - 3);
+        } else if (count == 19) {
+          bits.put(ptLen[0], ptCode[0]);
+          bits.put(ptLen[1], ptCode[1]);
+          bits.put(4, 15);
+        } else {
+          bits.put(ptLen[2], ptCode[2]);
+          bits.put(CBIT, count - 20);
+        }
+      } else {
+        bits.put(ptLen[k + 2], ptCode[k + 2]);
+      }
+    }
+  }
+
+  bitWriter bits;
+  uint8_t cLen[NC]{};
+  uint16_t cCode[NC]{};
+  uint8_t ptLen[NPT]{};
+  uint16_t ptCode[NPT]{};
+};
+
+uint32_t hash3(const uint8_t *p) {
+  uint32_t v = p[0] | p[1] << 8 | p[2] << 16;
+  return (v * 2654435761u) >> (32 - hashBits);
+}
+
+void compressChunk(std::span<const std::byte> src, std::vector<std::byte> &dest,
+                   int maxChain) {
+  auto *in = reinterpret_cast<const uint8_t *>(src.data());
+  uint32_t size = static_cast<uint32_t>(src.size());
+  std::vector<uint32_t> head(1u << hashBits, noPos);
+  std::vector<uint32_t> prev(size, noPos);
+  std::vector<token> tokens;
+  tokens.reserve(blockTokens);
+  encoder enc(dest);
+
+  auto insert = [&](uint32_t pos) {
+    if (pos + THRESHOLD <= size) {
+      uint32_t h = hash3(in + pos);
+      prev[pos] = head[h];
+      head[h] = pos;
+    }
+  };
+  auto emit = [&](token t) {
+    tokens.push_back(t);
+    if (tokens.size() == blockTokens) {
+      enc.sendBlock(tokens);
+      tokens.clear();
+    }
+  };
+
+  uint32_t pos = 0;
+  while (pos < size) {
+    uint32_t bestLen = 0, bestDist = 0;
+    if (pos + THRESHOLD <= size) {
+      uint32_t limit = std::min<uint32_t>(MAXMATCH, size - pos);
+      uint32_t candidate = head[hash3(in + pos)];
+      for (int chain = maxChain; chain > 0 && candidate != noPos &&
+                                 pos - candidate <= DICSIZ;
+           --chain, candidate = prev[candidate]) {
+        if (in[candidate + bestLen] != in[pos + bestLen]) {
+          continue;
+        }
+        uint32_t len = 0;
+        while (len < limit && in[candidate + len] == in[pos + len]) {
+          len++;
+        }
+        if (len > bestLen) {
+          bestLen = len;
+          bestDist = pos - candidate;
+          if (len == limit) {
+            break;
+          }
+        }
+      }
+    }
+    if (bestLen >= THRESHOLD) {
+      emit({static_cast<uint16_t>(bestLen + UINT8_MAX + 1 - THRESHOLD),
+            static_cast<uint16_t>(bestDist - 1)});
+      for (uint32_t end = pos + bestLen; pos < end; ++pos) {
+        insert(pos);
+      }
+    } else {
+      emit({in[pos], 0});
+      insert(pos++);
+    }
+  }
+  if (!tokens.empty()) {
+    enc.sendBlock(tokens);
+  }
+  enc.finish();
+}
+
+void putUint32(std::vector<std::byte> &dest, size_t at, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    dest[at + i] = static_cast<std::byte>(value >> (8 * i));
+  }
+}
+
+} // namespace
+
+void lz2k(std::span<const std::byte> src, std::vector<std::byte> &dest,
+          int level) {
+  int maxChain = 1 << std::clamp(level, 1, 9);
+  while (!src.empty()) {
+    auto chunk = src.first(std::min(src.size(), lz2kChunkSize));
+    size_t header = dest.size();
+    dest.resize(header + 12);
+    putUint32(dest, header, 0x4B325A4C); // "LZ2K"
+    putUint32(dest, header + 4, static_cast<uint32_t>(chunk.size()));
+    compressChunk(chunk, dest, maxChain);
+    putUint32(dest, header + 8,
+              static_cast<uint32_t>(dest.size() - header - 12));
+    src = src.subspan(chunk.size());
+  }
+}
@@ -0,0 +1,86 @@
+// manifest.cpp : Manifest of extracted files for incremental extraction.
+
+#include "include/manifest.h"
+#include "ttextract.h"
+#include <format>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+constexpr std::string_view header = "# ttextract manifest v1";
+
+std::string headerLine(bool isRaw) {
+  return std::format("{} raw={}", header, isRaw ? 1 : 0);
+}
+
+} // namespace
+
+void Manifest::load(const std::filesystem::path &outDir, bool isRaw) {
+  records.clear();
+  std::ifstream in(outDir / fileName);
+  std::string line;
+  if (!in || !std::getline(in, line) || line != headerLine(isRaw)) {
+    return;
+  }
+  // offset, packed size, unpacked size, packed type, crc, output size, mtime
+  // and path, tab separated
+  while (std::getline(in, line)) {
+    std::istringstream fields(line);
+    manifestRecord record;
+    std::string path;
+    if (fields >> record.offset >> record.packedSize >> record.unpackedSize >>
+            record.packedType >> record.crc >> record.outputSize >>
+            record.mtime &&
+        fields.get() == '\t' && std::getline(fields, path)) {
+      records[path] = record;
+    }
+  }
+}
+
+void Manifest::save(const std::filesystem::path &outDir, bool isRaw) const {
+  std::string out = headerLine(isRaw) + '\n';
+  for (const auto &[path, record] : records) {
+    out += std::format("{}\t{}\t{}\t{}\t{}\t{}\t{}\t{}\n", record.offset,
+                       record.packedSize, record.unpackedSize,
+                       record.packedType, record.crc, record.outputSize,
+                       record.mtime, path);
+  }
+  auto target = outDir / fileName;
+  auto temporary = target;
+  temporary += ".tmp";
+  {
+    std::ofstream dest(temporary, std::ios::out | std::ios::binary);
+    dest.write(out.data(), out.size());
+    if (!dest) {
+      logWarning("Could not write the extraction manifest.");
+      return;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temporary, target, error);
+  if (error) {
+    logWarning(std::format("Could not write the extraction manifest: {}",
+                           error.message()));
+  }
+}
+
+const manifestRecord *Manifest::find(const std::string &path) const {
+  auto found = records.find(path);
+  return found == records.end() ? nullptr : &found->second;
+}
+
+void Manifest::update(const std::string &path, const manifestRecord &record) {
+  records[path] = record;
+}
+
+bool Manifest::isCurrent(const manifestRecord &record,
+                         const std::filesystem::path &outputFile) {
+  std::error_code error;
+  auto size = std::filesystem::file_size(outputFile, error);
+  if (error || size != record.outputSize) {
+    return false;
+  }
+  auto mtime = std::filesystem::last_write_time(outputFile, error);
+  return !error && mtime.time_since_epoch().count() == record.mtime;
+}
@@ -0,0 +1,171 @@
+// mappedfile.cpp : Read-only file mappings for Windows and POSIX.
+
+#include "include/mappedfile.h"
+#include <algorithm>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <filesystem>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string &path) {
+  auto widePath = std::filesystem::path(path).wstring();
+  HANDLE file = CreateFileW(widePath.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return;
+  }
+  fileHandle = file;
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize)) {
+    close();
+    return;
+  }
+  length = static_cast<size_t>(fileSize.QuadPart);
+  opened = true;
+  // Empty files can't be mapped, but are still valid (empty) inputs
+  if (length == 0) {
+    return;
+  }
+  HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0,
+                                      nullptr);
+  if (!mapping) {
+    close();
+    return;
+  }
+  mappingHandle = mapping;
+  address = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!address) {
+    close();
+  }
+}
+
+void MappedFile::prefetch(uint64_t offset, size_t length) const {
+  if (!address || offset >= this->length) {
+    return;
+  }
+  WIN32_MEMORY_RANGE_ENTRY range{
+      const_cast<char *>(static_cast<const char *>(address)) + offset,
+      std::min<size_t>(length, this->length - offset)};
+  PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+// The file is opened without FILE_FLAG_SEQUENTIAL_SCAN since it's mostly
+// accessed through the mapping, where prefetch() does the read ahead.
+void MappedFile::adviseSequential() const {}
+
+void MappedFile::close() {
+  if (address) {
+    UnmapViewOfFile(address);
+  }
+  if (mappingHandle) {
+    CloseHandle(mappingHandle);
+  }
+  if (fileHandle) {
+    CloseHandle(fileHandle);
+  }
+  address = nullptr;
+  mappingHandle = nullptr;
+  fileHandle = nullptr;
+  length = 0;
+  opened = false;
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &path) {
+  fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+    close();
+    return;
+  }
+  length = static_cast<size_t>(info.st_size);
+  opened = true;
+  // Empty files can't be mapped, but are still valid (empty) inputs
+  if (length == 0) {
+    return;
+  }
+  void *mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapping == MAP_FAILED) {
+    close();
+    return;
+  }
+  address = mapping;
+}
+
+void MappedFile::prefetch(uint64_t offset, size_t length) const {
+  if (fd < 0 || offset >= this->length) {
+    return;
+  }
+  length = std::min<size_t>(length, this->length - offset);
+#if defined(__linux__)
+  // Reads into the page cache, which serves both the mapping and the kernel
+  // copies of stored entries
+  (void)posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(length),
+                      POSIX_FADV_WILLNEED);
+#else
+  // madvise wants a page aligned start
+  auto pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+  uint64_t start = offset & ~(pageSize - 1);
+  (void)madvise(const_cast<char *>(static_cast<const char *>(address)) + start,
+                length + (offset - start), MADV_WILLNEED);
+#endif
+}
+
+void MappedFile::adviseSequential() const {
+#if defined(__linux__)
+  if (fd >= 0) {
+    (void)posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+#endif
+}
+
+void MappedFile::close() {
+  if (address) {
+    munmap(const_cast<void *>(address), length);
+  }
+  if (fd >= 0) {
+    ::close(fd);
+  }
+  address = nullptr;
+  fd = -1;
+  length = 0;
+  opened = false;
+}
+
+#endif
+
+MappedFile::MappedFile(MappedFile &&other) noexcept { *this = std::move(other); }
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+  if (this != &other) {
+    close();
+    opened = std::exchange(other.opened, false);
+    address = std::exchange(other.address, nullptr);
+    length = std::exchange(other.length, 0);
+#ifdef _WIN32
+    fileHandle = std::exchange(other.fileHandle, nullptr);
+    mappingHandle = std::exchange(other.mappingHandle, nullptr);
+#else
+    fd = std::exchange(other.fd, -1);
+#endif
+  }
+  return *this;
+}
+
+MappedFile::~MappedFile() { close(); }
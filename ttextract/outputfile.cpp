@@ -0,0 +1,256 @@
+// outputfile.cpp : Directory creation and file writes for extraction.
+
+#include "include/outputfile.h"
+#include <algorithm>
+#include <cerrno>
+#include <unordered_set>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#endif
+
+namespace {
+
+// Below this, reserving space costs more than it saves
+constexpr size_t preallocateThreshold = 0x10000;
+
+} // namespace
+
+ttError createDirectories(std::vector<std::filesystem::path> dirs,
+                          std::string *detail) {
+  // Add missing ancestors, so that creating in sorted order never needs more
+  // than one level at a time
+  std::unordered_set<std::string> seen;
+  size_t given = dirs.size();
+  for (size_t i = 0; i < given; ++i) {
+    for (auto dir = dirs[i]; !dir.empty() && seen.insert(dir.string()).second;
+         dir = dir.parent_path()) {
+      if (dir != dirs[i]) {
+        dirs.push_back(dir);
+      }
+      if (dir == dir.parent_path()) {
+        break;
+      }
+    }
+  }
+  std::sort(dirs.begin(), dirs.end());
+  dirs.erase(std::unique(dirs.begin(), dirs.end()), dirs.end());
+  for (auto &dir : dirs) {
+    std::error_code error;
+    std::filesystem::create_directory(dir, error);
+    if (error && !std::filesystem::is_directory(dir)) {
+      if (detail) {
+        *detail = "Cannot create directory " + dir.string() + ": " + error.message();
+      }
+      return ttError::writeFailed;
+    }
+  }
+  return ttError::none;
+}
+
+ttError writeWholeFile(const std::filesystem::path &path,
+                       std::span<const std::byte> data) {
+  OutputFile file;
+  auto error = file.open(path, data.size());
+  if (error == ttError::none) {
+    error = file.write(data);
+  }
+  auto closeError = file.close();
+  return error != ttError::none ? error : closeError;
+}
+
+ttError linkOrCopy(const std::filesystem::path &target,
+                   const std::filesystem::path &path) {
+  std::error_code error;
+  if (std::filesystem::equivalent(target, path, error)) {
+    // Same file already, e.g. names differing only in case on a
+    // case-insensitive filesystem
+    return ttError::none;
+  }
+  std::filesystem::remove(path, error);
+  std::filesystem::create_hard_link(target, path, error);
+  if (!error) {
+    return ttError::none;
+  }
+  MappedFile source(target.string());
+  if (!source.isOpen()) {
+    return ttError::writeFailed;
+  }
+  return copyToFile(source, 0, source.size(), path);
+}
+
+OutputFile::~OutputFile() { (void)close(); }
+
+#ifdef _WIN32
+
+ttError OutputFile::open(const std::filesystem::path &path,
+                         size_t expectedSize) {
+  (void)close();
+  // Replace rather than truncate: an earlier --dedupe run may have left path
+  // hard linked to other outputs, which must keep their own contents
+  if (!DeleteFileW(path.c_str()) && GetLastError() != ERROR_FILE_NOT_FOUND) {
+    return ttError::writeFailed;
+  }
+  HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr,
+                            CREATE_NEW,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return ttError::writeFailed;
+  }
+  handle = file;
+  if (expectedSize >= preallocateThreshold) {
+    FILE_ALLOCATION_INFO allocation{};
+    allocation.AllocationSize.QuadPart = static_cast<LONGLONG>(expectedSize);
+    // Only a hint; writing works the same without it
+    SetFileInformationByHandle(file, FileAllocationInfo, &allocation,
+                               sizeof(allocation));
+  }
+  return ttError::none;
+}
+
+ttError OutputFile::write(std::span<const std::byte> data) {
+  if (!handle) {
+    return ttError::writeFailed;
+  }
+  while (!data.empty()) {
+    DWORD chunk = static_cast<DWORD>(std::min<size_t>(data.size(), 0x40000000));
+    DWORD written = 0;
+    if (!WriteFile(handle, data.data(), chunk, &written, nullptr) || !written) {
+      return ttError::writeFailed;
+    }
+    data = data.subspan(written);
+  }
+  return ttError::none;
+}
+
+ttError OutputFile::close() {
+  if (!handle) {
+    return ttError::none;
+  }
+  bool ok = CloseHandle(handle);
+  handle = nullptr;
+  return ok ? ttError::none : ttError::writeFailed;
+}
+
+ttError copyToFile(const MappedFile &source, uint64_t offset, size_t size,
+                   const std::filesystem::path &path) {
+  return writeWholeFile(path, source.bytes().subspan(offset, size));
+}
+
+#else
+
+namespace {
+
+int createOutput(const std::filesystem::path &path, size_t size) {
+  // Replace rather than truncate: an earlier --dedupe run may have left path
+  // hard linked to other outputs, which must keep their own contents
+  if (::unlink(path.c_str()) != 0 && errno != ENOENT) {
+    return -1;
+  }
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+#if defined(__linux__)
+  if (fd >= 0 && size >= preallocateThreshold) {
+    // Only a hint; filesystems without support just write normally
+    (void)posix_fallocate(fd, 0, static_cast<off_t>(size));
+  }
+#endif
+  return fd;
+}
+
+// Write all of data at the current position of fd
+bool writeAll(int fd, std::span<const std::byte> data) {
+  while (!data.empty()) {
+    ssize_t written = ::write(fd, data.data(), data.size());
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return false;
+    }
+    data = data.subspan(static_cast<size_t>(written));
+  }
+  return true;
+}
+
+#if defined(__linux__)
+// Copy in the kernel. Returns how many bytes were copied before the first
+// failure; callers fall back to writing the rest themselves.
+size_t kernelCopy(int in, int out, uint64_t offset, size_t size) {
+  size_t done = 0;
+  bool useCopyRange = true;
+  while (done < size) {
+    size_t chunk = std::min<size_t>(size - done, 0x40000000);
+    ssize_t copied;
+    if (useCopyRange) {
+      auto from = static_cast<off64_t>(offset + done);
+      copied = copy_file_range(in, &from, out, nullptr, chunk, 0);
+      if (copied < 0 && errno != EINTR) {
+        // Old kernels, or filesystems that can't: try sendfile instead
+        useCopyRange = false;
+        continue;
+      }
+    } else {
+      auto from = static_cast<off_t>(offset + done);
+      copied = sendfile(out, in, &from, chunk);
+      if (copied < 0 && errno != EINTR) {
+        break;
+      }
+    }
+    if (copied == 0) {
+      break;
+    }
+    if (copied > 0) {
+      done += static_cast<size_t>(copied);
+    }
+  }
+  return done;
+}
+#endif
+
+} // namespace
+
+ttError copyToFile(const MappedFile &source, uint64_t offset, size_t size,
+                   const std::filesystem::path &path) {
+  int fd = createOutput(path, size);
+  if (fd < 0) {
+    return ttError::writeFailed;
+  }
+  size_t done = 0;
+#if defined(__linux__)
+  done = kernelCopy(source.nativeHandle(), fd, offset, size);
+#endif
+  bool ok = writeAll(fd, source.bytes().subspan(offset + done, size - done));
+  ok = ::close(fd) == 0 && ok;
+  return ok ? ttError::none : ttError::writeFailed;
+}
+
+ttError OutputFile::open(const std::filesystem::path &path,
+                         size_t expectedSize) {
+  (void)close();
+  fd = createOutput(path, expectedSize);
+  return fd < 0 ? ttError::writeFailed : ttError::none;
+}
+
+ttError OutputFile::write(std::span<const std::byte> data) {
+  return fd >= 0 && writeAll(fd, data) ? ttError::none : ttError::writeFailed;
+}
+
+ttError OutputFile::close() {
+  if (fd < 0) {
+    return ttError::none;
+  }
+  bool ok = ::close(fd) == 0;
+  fd = -1;
+  return ok ? ttError::none : ttError::writeFailed;
+}
+
+#endif
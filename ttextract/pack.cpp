@@ -0,0 +1,129 @@
+// pack.cpp : Build a .DAT archive from a folder, the inverse of extraction.
+
+#include "ttextract.h"
+#include "include/datwriter.h"
+#include "include/lz2k.h"
+#include "include/manifest.h"
+#include "include/mappedfile.h"
+#include "include/pathfilter.h"
+#include "include/threadpool.h"
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Files compressed ahead of the writer per worker; bounds memory use while
+// keeping every worker busy
+constexpr size_t packBatchPerWorker = 4;
+
+struct packSource {
+  std::filesystem::path file;
+  std::string path; // Archive path, e.g. "\LEVELS\CITY\CITY.GSC"
+};
+
+// Every regular file under root selected by filter, in archive path order so
+// the same folder always packs to the same archive. skip (the archive being
+// written) and the manifests --incremental leaves behind are left out.
+std::vector<packSource> collectSources(const std::filesystem::path &root,
+                                       const PathFilter &filter,
+                                       const std::filesystem::path &skip) {
+  std::vector<packSource> sources;
+  std::error_code error;
+  auto skipCanonical = std::filesystem::weakly_canonical(skip, error);
+  std::filesystem::recursive_directory_iterator it(root, error), end;
+  for (; !error && it != end; it.increment(error)) {
+    // Entries that can't be inspected are skipped rather than ending the walk
+    std::error_code ignored;
+    if (!it->is_regular_file(ignored) ||
+        it->path().filename() == Manifest::fileName ||
+        std::filesystem::weakly_canonical(it->path(), ignored) == skipCanonical) {
+      continue;
+    }
+    auto path = '\\' + it->path().lexically_relative(root).generic_string();
+    std::replace(path.begin(), path.end(), '/', '\\');
+    if (filter.empty() || filter.matches(path)) {
+      sources.push_back({it->path(), std::move(path)});
+    }
+  }
+  if (error) {
+    logError(std::format("Cannot read folder {}: {}", root.string(), error.message()));
+    throw 1;
+  }
+  std::sort(sources.begin(), sources.end(),
+            [](const packSource &a, const packSource &b) { return a.path < b.path; });
+  return sources;
+}
+
+} // namespace
+
+void handlePack(const cmdlineArgs &args) {
+  std::filesystem::path root(args.fileName);
+  if (!std::filesystem::is_directory(root)) {
+    logError(std::format("{} is not a folder.", root.string()));
+    throw 1;
+  }
+  auto sources = collectSources(root, makeFilter(args), args.outName);
+  std::ofstream out(args.outName, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!out) {
+    logError(std::format("Cannot create {}.", args.outName));
+    throw 1;
+  }
+  DatWriter writer(out, args.signature);
+
+  // Compress a batch of files in parallel, then append it to the archive in
+  // order. Files that don't shrink are stored as they are.
+  ThreadPool pool(args.jobs);
+  size_t batchSize = pool.size() * packBatchPerWorker;
+  std::vector<MappedFile> inputs(batchSize);
+  std::vector<std::vector<std::byte>> packed(batchSize);
+  uint64_t totalIn = 0;
+  for (size_t start = 0; start < sources.size(); start += batchSize) {
+    size_t count = std::min(batchSize, sources.size() - start);
+    pool.parallelFor(count, [&](size_t i, unsigned) {
+      auto &source = sources[start + i];
+      inputs[i] = MappedFile(source.file.string());
+      if (!inputs[i].isOpen()) {
+        logError(std::format("Cannot open {}.", source.file.string()));
+        throw 1;
+      }
+      if (inputs[i].size() > UINT32_MAX) {
+        logError(std::format("{} is too large for a .DAT archive.", source.path));
+        throw 1;
+      }
+      packed[i].clear();
+      if (inputs[i].size() > 0) {
+        lz2k(inputs[i].bytes(), packed[i], args.level);
+      }
+    });
+    for (size_t i = 0; i < count; ++i) {
+      auto data = inputs[i].bytes();
+      bool compress = !packed[i].empty() && packed[i].size() < data.size();
+      auto error = writer.add(sources[start + i].path,
+                              compress ? std::span<const std::byte>(packed[i]) : data,
+                              static_cast<uint32_t>(data.size()), compress ? 2 : 0);
+      if (error != ttError::none) {
+        logError(std::format("Cannot add {}: {}", sources[start + i].path,
+                             describe(error)));
+        throw 1;
+      }
+      totalIn += data.size();
+      inputs[i] = MappedFile();
+    }
+  }
+  std::string detail;
+  checkError(writer.finish(&detail), detail);
+  out.close();
+  if (!out) {
+    logError(std::format("Error writing {}.", args.outName));
+    throw 1;
+  }
+  std::cout << std::format("Packed {} files, 0x{:X} bytes into {} (0x{:X} bytes)\n",
+                           sources.size(), totalIn, args.outName,
+                           std::filesystem::file_size(args.outName));
+}
@@ -0,0 +1,162 @@
+// pathfilter.cpp : Glob/regex selection of archive paths.
+
+#include "include/pathfilter.h"
+#include <algorithm>
+#include <cctype>
+
+namespace {
+
+char fold(char c) {
+  if (c == '/') {
+    return '\\';
+  }
+  return static_cast<char>(toupper(static_cast<unsigned char>(c)));
+}
+
+bool hasRoot(std::string_view path) {
+  return !path.empty() && (path.front() == '\\' || path.front() == '/');
+}
+
+std::string_view stripRoot(std::string_view path) {
+  if (hasRoot(path)) {
+    path.remove_prefix(1);
+  }
+  return path;
+}
+
+// States of the glob automaton: positions in the pattern that can be reached
+// after the text consumed so far. '*' positions also reach the next one.
+void closure(const std::string &glob, std::vector<char> &states) {
+  for (size_t i = 0; i < glob.size(); ++i) {
+    if (states[i] && glob[i] == '*') {
+      states[i + 1] = 1;
+    }
+  }
+}
+
+bool step(const std::string &glob, std::vector<char> &states,
+          std::vector<char> &next, char c) {
+  std::fill(next.begin(), next.end(), 0);
+  bool any = false;
+  for (size_t i = 0; i < glob.size(); ++i) {
+    if (!states[i]) {
+      continue;
+    }
+    if (glob[i] == '*') {
+      next[i] = 1;
+      any = true;
+    } else if (glob[i] == '?' || glob[i] == c) {
+      next[i + 1] = 1;
+      any = true;
+    }
+  }
+  states.swap(next);
+  closure(glob, states);
+  return any;
+}
+
+// Step through path as if it had a root separator. False once nothing can
+// match.
+bool feed(const std::string &glob, std::vector<char> &states,
+          std::vector<char> &next, std::string_view path) {
+  states[0] = 1;
+  closure(glob, states);
+  if (!hasRoot(path) && !step(glob, states, next, '\\')) {
+    return false;
+  }
+  for (char c : path) {
+    if (!step(glob, states, next, fold(c))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+PathFilter::pattern PathFilter::compile(std::string_view text) {
+  pattern result;
+  if (text.starts_with("re:")) {
+    result.isRegex = true;
+    result.regex = std::regex(std::string(text.substr(3)),
+                              std::regex::ECMAScript | std::regex::icase |
+                                  std::regex::optimize);
+    return result;
+  }
+  // Globs are matched against paths with their root separator, so "*\\X"
+  // finds X at the top level too. Other patterns are anchored at the root.
+  if (!hasRoot(text) && !text.starts_with('*')) {
+    result.glob += '\\';
+  }
+  for (char c : text) {
+    // Runs of '*' behave the same as a single one
+    if (c == '*' && !result.glob.empty() && result.glob.back() == '*') {
+      continue;
+    }
+    result.glob += fold(c);
+  }
+  return result;
+}
+
+void PathFilter::include(std::string_view pattern) {
+  includes.push_back(compile(pattern));
+}
+
+void PathFilter::exclude(std::string_view pattern) {
+  excludes.push_back(compile(pattern));
+}
+
+bool PathFilter::globMatch(const std::string &glob, std::string_view path) {
+  std::vector<char> states(glob.size() + 1), next(glob.size() + 1);
+  return feed(glob, states, next, path) && states[glob.size()];
+}
+
+bool PathFilter::globPrefix(const std::string &glob, std::string_view prefix,
+                            bool &coversAll) {
+  std::vector<char> states(glob.size() + 1), next(glob.size() + 1);
+  if (!feed(glob, states, next, prefix)) {
+    coversAll = false;
+    return false;
+  }
+  // Everything below matches if a reachable position has only '*' left
+  coversAll = false;
+  for (size_t i = 0; i < glob.size(); ++i) {
+    if (states[i] && glob.find_first_not_of('*', i) == std::string::npos) {
+      coversAll = true;
+    }
+  }
+  return true;
+}
+
+bool PathFilter::matches(std::string_view path) const {
+  auto test = [&](const pattern &p) {
+    if (p.isRegex) {
+      auto relative = stripRoot(path);
+      return std::regex_match(relative.begin(), relative.end(), p.regex);
+    }
+    return globMatch(p.glob, path);
+  };
+  if (!includes.empty() && std::none_of(includes.begin(), includes.end(), test)) {
+    return false;
+  }
+  return std::none_of(excludes.begin(), excludes.end(), test);
+}
+
+bool PathFilter::mayMatchUnder(std::string_view folderPath) const {
+  std::string prefix(folderPath);
+  if (!prefix.empty() && prefix.back() != '\\' && prefix.back() != '/') {
+    prefix += '\\';
+  }
+  bool coversAll;
+  for (const auto &p : excludes) {
+    if (!p.isRegex && globPrefix(p.glob, prefix, coversAll) && coversAll) {
+      return false;
+    }
+  }
+  if (includes.empty()) {
+    return true;
+  }
+  return std::any_of(includes.begin(), includes.end(), [&](const pattern &p) {
+    return p.isRegex || globPrefix(p.glob, prefix, coversAll);
+  });
+}
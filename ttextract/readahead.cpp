@@ -0,0 +1,50 @@
+// readahead.cpp : Offset ordered work queue with read ahead.
+
+#include "include/readahead.h"
+#include <algorithm>
+#include <numeric>
+
+ReadAheadQueue::ReadAheadQueue(const MappedFile &file,
+                               const std::vector<readRange> &ranges,
+                               uint64_t window)
+    : file(file), window(window), order(ranges.size()) {
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return ranges[a].offset < ranges[b].offset;
+  });
+  sorted.reserve(order.size());
+  for (auto item : order) {
+    sorted.push_back(ranges[item]);
+  }
+  file.adviseSequential();
+  if (!sorted.empty()) {
+    topUp(0);
+  }
+}
+
+void ReadAheadQueue::topUp(size_t index) {
+  const auto &range = sorted[index];
+  uint64_t end = range.offset + range.size;
+  if (end + window / 2 > prefetched) {
+    // Cover the item itself too, in case it starts past the window
+    uint64_t from = std::max(prefetched, range.offset);
+    uint64_t to = end + window;
+    file.prefetch(from, to - from);
+    prefetched = to;
+  }
+}
+
+bool ReadAheadQueue::next(size_t &item) {
+  size_t index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+  if (index >= order.size()) {
+    return false;
+  }
+  item = order[index];
+  // Top the window up once the workers are half way through it. Only one
+  // worker does so at a time; the others carry on rather than wait.
+  std::unique_lock lock(prefetchLock, std::try_to_lock);
+  if (lock) {
+    topUp(index);
+  }
+  return true;
+}
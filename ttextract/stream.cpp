@@ -0,0 +1,235 @@
+// stream.cpp : Write archive contents to standard output, raw or as tar.
+
+#include "ttextract.h"
+#include "include/datindex.h"
+#include "include/extractstats.h"
+#include "include/threadpool.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <format>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace {
+
+constexpr size_t tarBlock = 512;
+// Entries decoded ahead of the writer per worker; bounds memory use while
+// keeping every worker busy
+constexpr size_t batchPerWorker = 4;
+
+void writeOut(std::span<const std::byte> data) {
+  if (std::fwrite(data.data(), 1, data.size(), stdout) != data.size()) {
+    logError("Error writing to standard output.");
+    throw 1;
+  }
+}
+
+// POSIX ustar writer. Paths too long for the header use a pax extended
+// header instead.
+class tarWriter {
+public:
+  tarWriter() : mtime(std::time(nullptr)) {}
+
+  void file(const std::string &path, std::span<const std::byte> data) {
+    begin(path, data.size());
+    writeOut(data);
+    end(data.size());
+  }
+
+  // Headers of a file whose size bytes of data the caller writes next,
+  // followed by end()
+  void begin(const std::string &path, uint64_t size) {
+    if (!header(path, size, '0')) {
+      // Record the real path in a pax header, then a truncated ustar header
+      auto record = paxRecord("path", path);
+      header(std::format("PaxHeaders/{}", path.substr(path.size() - 80)),
+             record.size(), 'x');
+      writeOut(std::as_bytes(std::span(record)));
+      pad(record.size());
+      header(path.substr(path.size() - 99), size, '0');
+    }
+  }
+
+  void end(uint64_t size) { pad(size); }
+
+  // Stand-in data for the rest of a file that came up short
+  void zeroes(uint64_t size) {
+    static const std::byte block[tarBlock]{};
+    for (; size > 0; size -= std::min<uint64_t>(size, tarBlock)) {
+      writeOut(std::span(block, std::min<uint64_t>(size, tarBlock)));
+    }
+  }
+
+  void finish() {
+    std::byte zeroes[tarBlock * 2]{};
+    writeOut(zeroes);
+  }
+
+private:
+  // Returns false if path doesn't fit the name and prefix fields.
+  bool header(const std::string &path, uint64_t size, char type) {
+    char block[tarBlock]{};
+    std::string_view name = path, prefix;
+    if (path.size() > 100) {
+      // Split at a separator so the prefix is at most 155 characters and the
+      // rest at most 100
+      auto split = path.rfind('/', 155);
+      if (split == std::string::npos || path.size() - split - 1 > 100) {
+        return false;
+      }
+      prefix = name.substr(0, split);
+      name = name.substr(split + 1);
+    }
+    std::memcpy(block, name.data(), name.size());
+    std::memcpy(block + 345, prefix.data(), prefix.size());
+    octal(block + 100, 8, 0644);
+    octal(block + 108, 8, 0);
+    octal(block + 116, 8, 0);
+    octal(block + 124, 12, size);
+    octal(block + 136, 12, static_cast<uint64_t>(mtime));
+    block[156] = type;
+    std::memcpy(block + 257, "ustar", 6);
+    std::memcpy(block + 263, "00", 2);
+    // Checksum is computed with its own field as spaces
+    std::memset(block + 148, ' ', 8);
+    unsigned int sum = 0;
+    for (unsigned char c : block) {
+      sum += c;
+    }
+    octal(block + 148, 7, sum);
+    writeOut(std::as_bytes(std::span(block)));
+    return true;
+  }
+
+  static void octal(char *field, size_t width, uint64_t value) {
+    auto text = std::format("{:0{}o}", value, width - 1);
+    std::memcpy(field, text.data(), width - 1);
+  }
+
+  // "<length> key=value\n", where length counts itself
+  static std::string paxRecord(std::string_view key, std::string_view value) {
+    size_t body = key.size() + value.size() + 3;
+    size_t length = body + std::to_string(body).size();
+    if (std::to_string(length).size() != std::to_string(body).size()) {
+      length++;
+    }
+    return std::format("{} {}={}\n", length, key, value);
+  }
+
+  void pad(uint64_t size) {
+    if (auto rest = size % tarBlock) {
+      zeroes(tarBlock - rest);
+    }
+  }
+
+  std::time_t mtime;
+};
+
+std::string tarPath(const DatIndex &index, uint32_t item) {
+  auto path = index.path(item);
+  std::replace(path.begin(), path.end(), '\\', '/');
+  return path.substr(path.starts_with('/') ? 1 : 0);
+}
+
+// LZ2K entries too large to be worth a buffer of their own are decoded a
+// piece at a time as they're written, like extractEntry() does for files
+bool decodesWhileWriting(const DatIndex &index, uint32_t item, bool isRaw) {
+  auto info = index.fileInfo(item);
+  return !isRaw && info.packedType == 2 && info.packedSize != info.unpackedSize &&
+         info.unpackedSize >= streamDecodeThreshold &&
+         index.archive().inBounds(info);
+}
+
+// Runs on the writing thread while the pool is idle, as worker 0
+void writeWhileDecoding(const DatIndex &index, uint32_t item, bool isTar,
+                        tarWriter &tar, ExtractStats *stats) {
+  auto begin = ExtractStats::clock::now();
+  auto info = index.fileInfo(item);
+  if (isTar) {
+    tar.begin(tarPath(index, item), info.unpackedSize);
+  }
+  auto written = streamEntry(
+      index, item,
+      [](std::span<const std::byte> piece) {
+        writeOut(piece);
+        return true;
+      },
+      stats, 0);
+  if (written != info.unpackedSize) {
+    logWarning(std::format("{}: decoded 0x{:X} of 0x{:X} bytes", index.path(item),
+                           written, info.unpackedSize));
+    if (isTar) {
+      // The header already promised unpackedSize bytes
+      tar.zeroes(info.unpackedSize - written);
+    }
+  }
+  if (isTar) {
+    tar.end(info.unpackedSize);
+  }
+  if (stats) {
+    stats->addEntry(0, item, info, written, ExtractStats::clock::now() - begin);
+  }
+}
+
+} // namespace
+
+void streamDAT(const DatIndex &index, const cmdlineArgs &args,
+               ExtractStats *stats) {
+#ifdef _WIN32
+  _setmode(_fileno(stdout), _O_BINARY);
+#endif
+  static char outBuffer[0x100000];
+  std::setvbuf(stdout, outBuffer, _IOFBF, sizeof(outBuffer));
+
+  // Decode a batch of entries in parallel, then write it out in order
+  ThreadPool pool(args.jobs);
+  const auto &files = index.files();
+  size_t batchSize = pool.size() * batchPerWorker;
+  std::vector<std::vector<std::byte>> scratch(batchSize);
+  std::vector<std::span<const std::byte>> decoded(batchSize);
+  tarWriter tar;
+  for (size_t start = 0; start < files.size(); start += batchSize) {
+    size_t count = std::min(batchSize, files.size() - start);
+    pool.parallelFor(count, [&](size_t i, unsigned worker) {
+      if (decodesWhileWriting(index, files[start + i], args.isRaw)) {
+        return;
+      }
+      auto begin = ExtractStats::clock::now();
+      {
+        ExtractStats::timer timing(stats, worker, statPhase::DECODE);
+        decoded[i] = decodeEntry(index, files[start + i], args.isRaw, scratch[i]);
+      }
+      if (stats) {
+        stats->addEntry(worker, files[start + i], index.fileInfo(files[start + i]),
+                        decoded[i].size(), ExtractStats::clock::now() - begin);
+      }
+    });
+    // The pool is idle while the batch is written, so worker 0's counters
+    // are free to use
+    for (size_t i = 0; i < count; ++i) {
+      if (decodesWhileWriting(index, files[start + i], args.isRaw)) {
+        writeWhileDecoding(index, files[start + i], args.isTar, tar, stats);
+        continue;
+      }
+      ExtractStats::timer timing(stats, 0, statPhase::WRITE);
+      if (args.isTar) {
+        tar.file(tarPath(index, files[start + i]), decoded[i]);
+      } else {
+        writeOut(decoded[i]);
+      }
+    }
+  }
+  if (args.isTar) {
+    tar.finish();
+  }
+  // Whatever was still buffered can fail too, e.g. on a full disk
+  if (std::fflush(stdout) != 0) {
+    logError("Error writing to standard output.");
+    throw 1;
+  }
+}
@@ -0,0 +1,136 @@
+// threadpool.cpp : Work-stealing pool for parallel extraction.
+
+#include "include/threadpool.h"
+#include <algorithm>
+#include <utility>
+
+unsigned ThreadPool::workerCount(unsigned threadCount) {
+  return std::max(threadCount ? threadCount : std::thread::hardware_concurrency(),
+                  1u);
+}
+
+ThreadPool::ThreadPool(unsigned threadCount) : ranges(workerCount(threadCount)) {
+  threads.reserve(ranges.size());
+  for (unsigned i = 0; i < ranges.size(); ++i) {
+    threads.emplace_back([this, i] { workerLoop(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard guard(stateLock);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+void ThreadPool::parallelFor(size_t count, const task &body) {
+  if (count == 0) {
+    return;
+  }
+  size_t workers = ranges.size();
+  for (size_t i = 0; i < workers; ++i) {
+    std::lock_guard guard(ranges[i].lock);
+    ranges[i].next = count * i / workers;
+    ranges[i].end = count * (i + 1) / workers;
+  }
+  std::unique_lock lock(stateLock);
+  job = &body;
+  error = nullptr;
+  cancelled = false;
+  running = static_cast<unsigned>(workers);
+  generation++;
+  wake.notify_all();
+  finished.wait(lock, [this] { return running == 0; });
+  job = nullptr;
+  if (error) {
+    std::rethrow_exception(std::exchange(error, nullptr));
+  }
+}
+
+void ThreadPool::workerLoop(unsigned worker) {
+  uint64_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock lock(stateLock);
+      wake.wait(lock, [&] { return stopping || generation != seen; });
+      if (stopping) {
+        return;
+      }
+      seen = generation;
+    }
+    runItems(worker);
+    std::lock_guard guard(stateLock);
+    if (--running == 0) {
+      finished.notify_all();
+    }
+  }
+}
+
+void ThreadPool::runItems(unsigned worker) {
+  size_t index;
+  while (takeOwn(worker, index) || steal(worker, index)) {
+    if (cancelled) {
+      return;
+    }
+    try {
+      (*job)(index, worker);
+    } catch (...) {
+      std::lock_guard guard(stateLock);
+      if (!error) {
+        error = std::current_exception();
+      }
+      cancelled = true;
+      return;
+    }
+  }
+}
+
+bool ThreadPool::takeOwn(unsigned worker, size_t &index) {
+  auto &own = ranges[worker];
+  std::lock_guard guard(own.lock);
+  if (own.next == own.end) {
+    return false;
+  }
+  index = own.next++;
+  return true;
+}
+
+bool ThreadPool::steal(unsigned worker, size_t &index) {
+  while (true) {
+    // Pick the victim with the most work left
+    size_t victim = worker, most = 0;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+      if (i == worker) {
+        continue;
+      }
+      std::lock_guard guard(ranges[i].lock);
+      if (ranges[i].end - ranges[i].next > most) {
+        most = ranges[i].end - ranges[i].next;
+        victim = i;
+      }
+    }
+    if (most == 0) {
+      return false;
+    }
+    size_t begin, end;
+    {
+      std::lock_guard guard(ranges[victim].lock);
+      size_t left = ranges[victim].end - ranges[victim].next;
+      if (left == 0) {
+        continue; // Someone got there first
+      }
+      end = ranges[victim].end;
+      begin = end - (left + 1) / 2;
+      ranges[victim].end = begin;
+    }
+    std::lock_guard guard(ranges[worker].lock);
+    ranges[worker].next = begin + 1;
+    ranges[worker].end = end;
+    index = begin;
+    return true;
+  }
+}
@@ -0,0 +1,161 @@
+// ttarchive.cpp : Random-access library interface to .DAT archives.
+
+#include "include/ttarchive.h"
+#include "include/entrycache.h"
+#include "include/filereading.h"
+#include "include/unlz2k.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Path in the form stored in the archive: backslashes and a leading separator
+std::string archivePath(std::string_view path) {
+  std::string out;
+  out.reserve(path.size() + 1);
+  if (!path.starts_with('\\') && !path.starts_with('/')) {
+    out += '\\';
+  }
+  for (char c : path) {
+    out += c == '/' ? '\\' : c;
+  }
+  return out;
+}
+
+// Only ASCII letters are folded, as for the path hash (see datindex.cpp);
+// bytes from 0x80 up must match exactly whatever the locale
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+  auto fold = [](char c) {
+    auto byte = static_cast<unsigned char>(c);
+    return byte >= 'a' && byte <= 'z' ? byte - 'a' + 'A' : byte;
+  };
+  return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+                    [&](char x, char y) { return fold(x) == fold(y); });
+}
+
+} // namespace
+
+Archive::~Archive() { useCache(nullptr); }
+
+void Archive::useCache(EntryCache *newCache) {
+  if (cache && cache != newCache) {
+    cache->forget(*this);
+  }
+  cache = newCache;
+}
+
+ttError Archive::open(const std::string &path, std::unique_ptr<Archive> &archive,
+                      std::string *detail) {
+  archive.reset();
+  std::unique_ptr<Archive> opened(new Archive());
+  opened->file = MappedFile(path);
+  if (!opened->file.isOpen()) {
+    if (detail) {
+      *detail = "Cannot open " + path;
+    }
+    return ttError::cannotOpen;
+  }
+  auto error = opened->load(opened->file.bytes(), detail);
+  if (error == ttError::none) {
+    archive = std::move(opened);
+  }
+  return error;
+}
+
+ttError Archive::open(std::span<const std::byte> bytes,
+                      std::unique_ptr<Archive> &archive, std::string *detail) {
+  archive.reset();
+  std::unique_ptr<Archive> opened(new Archive());
+  auto error = opened->load(bytes, detail);
+  if (error == ttError::none) {
+    archive = std::move(opened);
+  }
+  return error;
+}
+
+ttError Archive::load(std::span<const std::byte> bytes, std::string *detail) {
+  // .FPK archives start with this magic and aren't supported here
+  if (bytes.size() >= 4 && readUint32(bytes, 0, ENDIAN::little) == 0x12345678) {
+    if (detail) {
+      *detail = "Only .DAT archives can be opened";
+    }
+    return ttError::unrecognizedFormat;
+  }
+  if (auto error = archive.parse(bytes, detail); error != ttError::none) {
+    return error;
+  }
+  if (auto error = index.build(archive, nullptr, detail); error != ttError::none) {
+    return error;
+  }
+  files.reserve(index.files().size());
+  byHash.reserve(index.files().size());
+  std::string scratch;
+  for (auto item : index.files()) {
+    scratch.clear();
+    index.appendPath(item, scratch);
+    byHash.emplace_back(pathHash(scratch), static_cast<uint32_t>(files.size()));
+    files.push_back({item, index.fileInfo(item)});
+  }
+  std::sort(byHash.begin(), byHash.end());
+  return ttError::none;
+}
+
+const archiveEntry *Archive::find(std::string_view path) const {
+  auto wanted = archivePath(path);
+  auto [first, last] = std::equal_range(
+      byHash.begin(), byHash.end(), std::pair(pathHash(wanted), uint32_t{0}),
+      [](const auto &a, const auto &b) { return a.first < b.first; });
+  // Hashes can collide, so confirm with the full path
+  for (auto it = first; it != last; ++it) {
+    const auto &entry = files[it->second];
+    if (equalsIgnoreCase(index.path(entry.item), wanted)) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+ttError Archive::read(const archiveEntry &entry, std::span<std::byte> out) const {
+  const auto &info = entry.info;
+  if (out.size() < info.unpackedSize) {
+    return ttError::bufferTooSmall;
+  }
+  if (!archive.inBounds(info)) {
+    return ttError::truncated;
+  }
+  auto payload = archive.payload(info);
+  auto dest = out.first(info.unpackedSize);
+  if (info.packedSize == info.unpackedSize) {
+    std::memcpy(dest.data(), payload.data(), payload.size());
+    return ttError::none;
+  }
+  if (info.packedType != 2) {
+    return ttError::unknownPackedType;
+  }
+  if (unlz2k(payload, dest) != dest.size()) {
+    return ttError::corruptData;
+  }
+  return ttError::none;
+}
+
+ttError Archive::read(const archiveEntry &entry, entryData &out) const {
+  out = {};
+  if (cache) {
+    return cache->get(*this, entry, out);
+  }
+  const auto &info = entry.info;
+  if (info.packedSize == info.unpackedSize) {
+    if (!archive.inBounds(info)) {
+      return ttError::truncated;
+    }
+    out.bytes = archive.payload(info);
+    return ttError::none;
+  }
+  auto buffer = std::make_shared<std::vector<std::byte>>(info.unpackedSize);
+  auto error = read(entry, *buffer);
+  if (error == ttError::none) {
+    out.bytes = *buffer;
+    out.holder = std::move(buffer);
+  }
+  return error;
+}
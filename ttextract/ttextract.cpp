@@ -3,75 +3,42 @@
 //
 
 #include "ttextract.h"
-#include "include\filereading.h"
-#include "include\unlz2k.h"
+#include "include/archiveview.h"
+#include "include/datindex.h"
+#include "include/extractstats.h"
+#include "include/filereading.h"
+#include "include/manifest.h"
+#include "include/mappedfile.h"
+#include "include/outputfile.h"
+#include "include/readahead.h"
+#include "include/threadpool.h"
+#include "include/unlz2k.h"
+#include <algorithm>
 #include <cctype>
+#include <chrono>
 #include <filesystem>
 #include <format>
 #include <iostream>
+#include <memory>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
-bool initialized = false;
-char *outfileBuffer;
-
-// Via http://www.isthe.com/chongo/tech/comp/fnv/
-constexpr unsigned int FNV_BASIS = 2166136261;
-// constexpr unsigned int FNV_PRIME = 16777619;
-constexpr unsigned int FNV_PRIME = 1677619;
-
-constexpr std::string nameOfAlg(int packedType) {
-  switch (packedType) {
-    using enum algType;
-  case 0:
-    return "----";
-  case 2:
-    return "LZ2K";
-  default:
-    return "????";
-  }
-}
-
-const std::vector<int> validSignatures{-1, -2, -3, -4};
-
-void init() {
-  // 1 MB file output buffer
-  outfileBuffer = new char[0x100000];
-}
-
 int main(int argc, char *argv[]) {
-  if (!initialized) {
-    init();
-    initialized = true;
-  }
   cmdlineArgs args;
   try {
     args = parseArgs(argc, argv);
   } catch (int errorCode) {
     return errorCode;
   }
-  std::ifstream in(static_cast<std::string>(args.fileName),
-                   std::ios::in | std::ios::binary);
-  if (!in) {
-    std::cerr << "Cannot open source file.\n";
-    return 1;
-  }
-  if (args.isUnpack) {
-    // TODO: Replace
-    std::ofstream dest(args.outName, std::ios::out | std::ios::binary);
-    unlz2k(in, dest);
-    return 0;
-  }
-  in.seekg(0, std::ios_base::end);
-  size_t fileSize = in.tellg();
-  in.seekg(0);
-  // First word of file should determine what type of file we're extracting
-  int firstWord = readUint32(in, ENDIAN::little);
-  if (firstWord == 0x12345678) {
-    // Assume .FPK
+  if (args.isPack || !args.diffName.empty() || !args.fileNames.empty()) {
     try {
-      handleFPK(in, fileSize, args);
+      if (args.isPack) {
+        handlePack(args);
+      } else if (!args.diffName.empty()) {
+        handleDiff(args);
+      } else {
+        handleBatch(args);
+      }
     } catch (int errorCode) {
       std::cerr << "Program exited with code " << errorCode << '\n';
       return errorCode;
@@ -80,256 +47,446 @@ int main(int argc, char *argv[]) {
       return 1;
     }
     return 0;
-  } else {
-    // Assume .DAT
-    uint32_t fileInfoOffset = firstWord;
-    // If larger than end of file, try 2s complement >> 8
-    if (firstWord > fileSize) {
-      fileInfoOffset = (~fileInfoOffset + 1) << 8;
-    }
-    try {
-      handleDAT(in, fileSize, args, fileInfoOffset);
-    } catch (int errorCode) {
-      std::cerr << "Program exited with code " << errorCode << '\n';
-      return errorCode;
-    } catch (const std::exception &e) {
-      std::cerr << "Error: " << e.what();
-      return 1;
+  }
+  MappedFile in(static_cast<std::string>(args.fileName));
+  if (!in.isOpen()) {
+    std::cerr << "Cannot open source file.\n";
+    return 1;
+  }
+  if (args.isUnpack) {
+    return handleUnpack(in.bytes(), args);
+  }
+  if (in.size() < 4) {
+    logError("Unrecognized archive type.");
+    return 1;
+  }
+  // First word of file should determine what type of file we're extracting
+  auto firstWord = readUint32(in.bytes(), 0, ENDIAN::little);
+  try {
+    if (firstWord == 0x12345678) {
+      // Assume .FPK
+      handleFPK(in.bytes());
+    } else {
+      // Assume .DAT
+      handleDAT(in, args);
     }
-    return 0;
+  } catch (int errorCode) {
+    std::cerr << "Program exited with code " << errorCode << '\n';
+    return errorCode;
+  } catch (const std::exception &e) {
+    std::cerr << "Error: " << e.what();
+    return 1;
   }
-  logError("Unrecognized archive type.");
-  return 1;
+  return 0;
 }
 
-std::string readName(std::ifstream &src, size_t offsetInFile) {
-  auto currOffset = src.tellg();
-  src.seekg(offsetInFile);
-  std::string itemName = "";
-  char buffer;
-  src.read(&buffer, 1);
-  while (buffer) {
-    itemName += buffer;
-    src.read(&buffer, 1);
-  }
-  src.seekg(currOffset);
-  return itemName;
+int handleUnpack(std::span<const std::byte> src, cmdlineArgs &args) {
+  auto packed = src;
+  if (args.packedSize != -1 && static_cast<size_t>(args.packedSize) < src.size()) {
+    packed = src.first(args.packedSize);
+  }
+  size_t unpackedSize =
+      args.size != -1 ? static_cast<size_t>(args.size) : lz2kUnpackedSize(packed);
+  if (!unpackedSize) {
+    logError("Unpacked size unknown. Specify it with -s or --size.");
+    return 1;
+  }
+  std::vector<std::byte> unpacked(unpackedSize);
+  if (args.benchRuns > 0) {
+    benchmarkUnlz2k(packed, unpacked, args.benchRuns);
+  }
+  auto written = unlz2k(packed, unpacked);
+  if (written != unpackedSize) {
+    logWarning(std::format("Decoded 0x{:X} of 0x{:X} bytes, input may be corrupt",
+                           written, unpackedSize));
+  }
+  std::ofstream dest(args.outName, std::ios::out | std::ios::binary);
+  if (!dest) {
+    logError("Error opening destination file.");
+    return 1;
+  }
+  dest.write(reinterpret_cast<const char *>(unpacked.data()), written);
+  return 0;
 }
 
-void handleFPK(std::ifstream &src, size_t fileSize, cmdlineArgs &args) {
-  return;
+void benchmarkUnlz2k(std::span<const std::byte> packed,
+                     std::span<std::byte> unpacked, int runs) {
+  using clock = std::chrono::steady_clock;
+  // Warm up caches and page in the output buffer
+  (void)unlz2k(packed, unpacked);
+  auto start = clock::now();
+  for (int i = 0; i < runs; ++i) {
+    (void)unlz2k(packed, unpacked);
+  }
+  std::chrono::duration<double> elapsed = clock::now() - start;
+  double seconds = elapsed.count() / runs;
+  std::cout << std::format("Decoded {} bytes -> {} bytes, {} runs\n",
+                           packed.size(), unpacked.size(), runs);
+  std::cout << std::format("Average: {:.3f} ms, {:.1f} MB/s out, {:.1f} MB/s in\n",
+                           seconds * 1000, unpacked.size() / seconds / 1e6,
+                           packed.size() / seconds / 1e6);
 }
 
-void handleDAT(std::ifstream &src, size_t fileSize, cmdlineArgs &args,
-               unsigned int firstWord) {
+void handleFPK(std::span<const std::byte> src) {
+  // There is no .FPK reader: listing, filtering and extracting them all need
+  // the table layout after the magic, which hasn't been worked out yet. Until
+  // then fail, rather than exit successfully without extracting anything.
+  logError(std::format(".FPK archives ({} bytes) aren't supported yet.",
+                       src.size()));
+  throw 1;
+}
 
-  // First, the file info section
-  auto fileInfoOffset = firstWord;
-  auto fileInfoSize = readUint32(src, ENDIAN::little);
-  auto expectedSize = fileInfoOffset + fileInfoSize;
-  if (expectedSize != fileSize) {
-    std::cerr << std::format("Size mismatch. Expected 0x{:<8X}, got 0x{:<8X}",
-                             expectedSize, fileSize);
-    throw 1;
+void handleDAT(const MappedFile &in, cmdlineArgs &args) {
+  auto src = in.bytes();
+  std::unique_ptr<ExtractStats> stats;
+  if (args.isStats) {
+    stats = std::make_unique<ExtractStats>(ThreadPool::workerCount(args.jobs),
+                                           slowestEntries);
   }
-  src.seekg(fileInfoOffset);
-  auto signature = readInt32(src, ENDIAN::little);
-  if (!std::count(validSignatures.begin(), validSignatures.end(), signature)) {
-    std::cerr << std::format("File signature {} invalid.\n", signature);
-    throw 1;
+  ArchiveView archive;
+  std::string detail;
+  {
+    ExtractStats::timer timing(stats.get(), 0, statPhase::PARSE);
+    checkError(archive.parse(src, &detail), detail);
   }
-  std::cout << "DAT file with signature: " << signature << '\n';
-  auto numFiles = readUint32(src, ENDIAN::little);
-  fileInfoOffset += 8;
-  std::cout << std::format("File info offset: 0x{:<8X}\n", fileInfoOffset);
-  std::cout << std::format("File info size: 0x{:<8X}\n", fileInfoSize);
-  std::cout << std::format("Number of files: {}\n", numFiles);
-
-  // Name info section
-  auto nameInfoOffset = fileInfoOffset + (numFiles << 4);
-  src.seekg(nameInfoOffset);
-  auto numNames = readUint32(src, ENDIAN::little);
-  nameInfoOffset += 4;
-  std::cout << std::format("Name info offset: 0x{:<8X}\n", nameInfoOffset);
-  std::cout << std::format("Number of names: {}\n", numNames);
+  auto filter = makeFilter(args);
+  DatIndex index;
+  auto resolve = [&] {
+    ExtractStats::timer timing(stats.get(), 0, statPhase::RESOLVE);
+    checkError(index.build(archive, &filter, &detail), detail);
+  };
+  if (args.isList) {
+    resolve();
+    listDAT(index, args);
+    return;
+  }
+  if (args.isVerify) {
+    resolve();
+    verifyDAT(index, args, stats.get());
+    return;
+  }
+  // Everything that writes files checks the whole archive first, so a bad
+  // entry or name stops it before anything is written
+  auto resolveForOutput = [&] {
+    resolve();
+    ExtractStats::timer timing(stats.get(), 0, statPhase::VALIDATE);
+    checkError(index.validate(&detail), detail);
+  };
+  if (args.toStdout || args.isTar) {
+    resolveForOutput();
+    streamDAT(index, args, stats.get());
+    if (stats) {
+      // Standard output holds the extracted data
+      stats->print(std::cerr, index, args.isJson);
+    }
+    return;
+  }
+  std::cout << "DAT file with signature: " << archive.signature() << '\n';
+  std::cout << std::format("Byte order: {} endian\n",
+                           archive.endianness() == ENDIAN::big ? "big" : "little");
+  std::cout << std::format("File info offset: 0x{:<8X}\n", archive.fileInfoOffset());
+  std::cout << std::format("File info size: 0x{:<8X}\n", archive.fileInfoSize());
+  std::cout << std::format("Number of files: {}\n", archive.numFiles());
+  std::cout << std::format("Name info offset: 0x{:<8X}\n", archive.nameInfoOffset());
+  std::cout << std::format("Number of names: {}\n", archive.numNames());
+  std::cout << std::format("Name data offset: 0x{:<8X}\n", archive.nameDataOffset());
+  std::cout << std::format("Name CRC offset: 0x{:<8X}\n", archive.nameCRCOffset());
+  std::cout << std::format("Number of CRCs: {}\n\n",
+                           archive.hasCRCs() ? archive.numFiles() : 0);
 
-  // Name data section
-  auto nameDataOffset = nameInfoOffset + (numNames << 3);
-  src.seekg(nameDataOffset);
-  auto nameCRCOffset = readUint32(src, ENDIAN::little);
-  nameDataOffset += 4;
-  nameCRCOffset += nameDataOffset;
-  std::cout << std::format("Name data offset: 0x{:<8X}\n", nameDataOffset);
-  std::cout << std::format("Name CRC offset: 0x{:<8X}\n", nameCRCOffset);
+  // Phase one: resolve the name tree into a flat index
+  resolveForOutput();
+  ThreadPool pool(args.jobs);
+  extractDAT(in, index, args, pool, stats.get());
+}
 
-  // CRC section
-  std::unordered_map<unsigned int, unsigned short int> crcToIndex;
-  bool hasCRCs = false;
-  src.seekg(nameCRCOffset);
-  if (src.tellg() != fileSize) {
-    auto first = readUint32(src, ENDIAN::little);
-    if (first) {
-      hasCRCs = true;
-      crcToIndex[first] = 0;
-      for (uint32_t i = 1; i < numFiles; ++i) {
-        auto crc = readUint32(src, ENDIAN::little);
-        crcToIndex[crc] = i;
-      }
-      // Should have two dwords left, expecting zeroes
-      unsigned int end = readUint32(src, ENDIAN::little);
-      end += readUint32(src, ENDIAN::little);
-      if (end) {
-        logError(std::format("Unexpected non-zero bytes at 0x{:<8X}\n",
-                             static_cast<int>(src.tellg()) - 8));
-        throw 1;
-      }
-      if (src.tellg() != fileSize) {
-        logError(std::format("Unexpected non-zero data at 0x{:<8X}\n",
-                             static_cast<int>(src.tellg())));
-        throw 1;
+size_t extractDAT(const MappedFile &in, const DatIndex &index,
+                  const cmdlineArgs &args, ThreadPool &pool,
+                  ExtractStats *stats) {
+  std::string detail;
+  Manifest manifest;
+  std::vector<uint32_t> pending;
+  if (args.isIncremental) {
+    manifest.load(args.outDir, args.isRaw);
+    for (auto item : index.files()) {
+      auto *record = manifest.find(index.path(item));
+      if (!record || *record != manifestRecordFor(index, item, *record) ||
+          !Manifest::isCurrent(*record, index.outputPath(args.outDir, item))) {
+        pending.push_back(item);
       }
     }
+  } else {
+    pending = index.files();
   }
-  std::cout << std::format("Number of CRCs: {}\n\n", crcToIndex.size());
   std::cout << "Offset  \tPacked  \tUnpacked\tAlg?\tFile\n";
   std::cout << std::string(100, '-') << '\n';
-  /*
-  Now the extraction section!
+  for (auto item : pending) {
+    auto info = index.fileInfo(item);
+    std::cout << std::format("{:0>8X}\t{:<8X}\t{:<8X}\t{}\t{}{}\n", info.offset,
+                             info.packedSize, info.unpackedSize,
+                             nameOfAlg(info.packedType), args.outDir,
+                             index.path(item));
+  }
+  if (args.isIncremental) {
+    std::cout << std::format("Skipped {} unchanged files\n",
+                             index.files().size() - pending.size());
+  }
+
+  // Phase two: create every output directory once, up front
+  {
+    ExtractStats::timer timing(stats, 0, statPhase::MKDIR);
+    std::vector<std::filesystem::path> dirs;
+    dirs.reserve(pending.size());
+    for (auto item : pending) {
+      dirs.push_back(index.outputPath(args.outDir, item).parent_path());
+    }
+    checkError(createDirectories(std::move(dirs), &detail), detail);
+  }
+
+  // Phase three: decode and write entries in parallel, each worker with its
+  // own scratch buffer over the shared mapping. With --dedupe, entries
+  // sharing their data are written once and linked afterwards.
+  dedupePlan plan;
+  if (args.isDedupe) {
+    plan = planDedupe(index, pending, args.isDedupeContent, pool);
+  }
+  const auto &toWrite = args.isDedupe ? plan.unique : pending;
+  std::vector<std::vector<std::byte>> scratch(pool.size());
+  forEachInFileOrder(pool, in, index, toWrite, [&](size_t i, unsigned worker) {
+    extractEntry(index, in, toWrite[i], args, scratch[worker], stats, worker);
+  });
+  // Only once every original is written and closed are they linked to
+  pool.parallelFor(plan.copies.size(), [&](size_t i, unsigned worker) {
+    ExtractStats::timer timing(stats, worker, statPhase::WRITE);
+    auto [copy, original] = plan.copies[i];
+    auto output = index.outputPath(args.outDir, copy);
+    if (linkOrCopy(index.outputPath(args.outDir, original), output) != ttError::none) {
+      logError(std::format("Error writing destination file {}.", output.string()));
+      throw 1;
+    }
+  });
+  if (args.isDedupe) {
+    std::cout << std::format("Linked {} duplicate files to {} written\n",
+                             plan.copies.size(), plan.unique.size());
+  }
 
-  Name info table items are 8 bytes long.
+  if (args.isIncremental) {
+    for (auto item : pending) {
+      auto output = index.outputPath(args.outDir, item);
+      std::error_code error;
+      manifestRecord record{};
+      record.outputSize = std::filesystem::file_size(output, error);
+      record.mtime =
+          std::filesystem::last_write_time(output, error).time_since_epoch().count();
+      manifest.update(index.path(item), manifestRecordFor(index, item, record));
+    }
+    manifest.save(args.outDir, args.isRaw);
+  }
+  if (stats) {
+    stats->print(std::cout, index, args.isJson);
+  }
+  return pending.size();
+}
 
-  First value is signed 16 bit.
-      If positive, read folder name. Value is index for last item in folder.
-      If negative or zero, read file name. Value is 2s complement of file ID.
+void forEachInFileOrder(ThreadPool &pool, const MappedFile &source,
+                        const DatIndex &index, const std::vector<uint32_t> &items,
+                        const std::function<void(size_t, unsigned)> &body) {
+  std::vector<readRange> ranges;
+  ranges.reserve(items.size());
+  for (auto item : items) {
+    auto info = index.fileInfo(item);
+    ranges.push_back({info.offset, info.packedSize});
+  }
+  ReadAheadQueue queue(source, ranges);
+  // One long running task per worker, each taking the next entry in file
+  // order, so together they sweep through the archive once
+  pool.parallelFor(pool.size(), [&](size_t, unsigned worker) {
+    size_t i;
+    try {
+      while (queue.next(i)) {
+        body(i, worker);
+      }
+    } catch (...) {
+      queue.stop();
+      throw;
+    }
+  });
+}
 
-  Second value is signed 16 bit.
-      If positive, use previous file path. Value is index of previous item
-  written in directory If zero, do not use previous file path. Write item to
-  current directory.
+manifestRecord manifestRecordFor(const DatIndex &index, uint32_t item,
+                                 const manifestRecord &output) {
+  auto info = index.fileInfo(item);
+  auto record = output;
+  record.offset = info.offset;
+  record.packedSize = info.packedSize;
+  record.unpackedSize = info.unpackedSize;
+  record.packedType = info.packedType;
+  record.crc = pathHash(index.path(item));
+  return record;
+}
 
-  Third value is relative 32-bit offset to read name from. This is added to the
-  name data offset.
-  */
+std::span<const std::byte> decodeEntry(const DatIndex &index, uint32_t item,
+                                       bool isRaw,
+                                       std::vector<std::byte> &scratch) {
+  auto info = index.fileInfo(item);
+  if (!index.archive().inBounds(info)) {
+    logError(std::format("File data at 0x{:<8X} runs past end of file",
+                         info.offset));
+    throw 1;
+  }
+  auto payload = index.archive().payload(info);
+  if (isRaw || info.packedSize == info.unpackedSize) {
+    return payload;
+  }
+  if (info.packedType != 2) {
+    logWarning(std::format("Unknown packed type {}, unpacking raw file",
+                           info.packedType));
+    return payload;
+  }
+  scratch.resize(info.unpackedSize);
+  auto written = unlz2k(payload, scratch);
+  if (written != info.unpackedSize) {
+    logWarning(std::format("{}: decoded 0x{:X} of 0x{:X} bytes",
+                           index.path(item), written, info.unpackedSize));
+  }
+  return std::span(scratch).first(written);
+}
 
-  src.seekg(nameInfoOffset);
-  uint16_t lastItemOffset = 0;
-  std::string currentDir{""};
-  std::unordered_map<uint16_t, std::string> itemDirs;
-  for (uint16_t nameOffset = 0; nameOffset < numNames; ++nameOffset) {
-    bool isFolder = false, isPacked = false;
-    std::string itemName{""};
-    int fileID = -1;
-    int16_t readType = readInt16(src, ENDIAN::little);
-    if (readType > 0) {
-      lastItemOffset = readType;
-      isFolder = true;
-    } else {
-      fileID = readType * -1;
+size_t streamEntry(
+    const DatIndex &index, uint32_t item,
+    const std::function<bool(std::span<const std::byte>)> &write,
+    ExtractStats *stats, unsigned worker) {
+  auto info = index.fileInfo(item);
+  auto payload = index.archive().payload(info);
+  Lz2kStream decoder(info.unpackedSize);
+  std::vector<std::byte> piece(streamPieceSize);
+  size_t fed = 0;
+  size_t written = 0;
+  while (!decoder.finished() && !decoder.failed()) {
+    size_t got;
+    bool refilled = false;
+    {
+      ExtractStats::timer timing(stats, worker, statPhase::DECODE);
+      if (fed == 0 || decoder.needsInput()) {
+        size_t size = std::min(streamPieceSize, payload.size() - fed);
+        decoder.feed(payload.subspan(fed, size), fed + size == payload.size());
+        fed += size;
+        refilled = true;
+      }
+      got = decoder.drain(piece);
     }
-    int16_t pathType = readInt16(src, ENDIAN::little);
-    if (pathType > 0) {
-      itemName = itemDirs.at(pathType);
-    } else {
-      itemName = currentDir;
+    if (got == 0 && !refilled) {
+      break;
     }
-    itemDirs[nameOffset] = itemName;
-    uint32_t nameDataRelativeOffset = readUint32(src, ENDIAN::little);
-
-    // Get name
-    auto name = readName(src, static_cast<size_t>(nameDataOffset) +
-                                      nameDataRelativeOffset);
-    if (!name.empty()) {
-      itemName += '\\';
+    ExtractStats::timer timing(stats, worker, statPhase::WRITE);
+    if (!write(std::span(piece).first(got))) {
+      break;
     }
-    itemName += name;
+    written += got;
+  }
+  return written;
+}
 
-    if (isFolder) {
-      if (!itemName.empty()) {
-        currentDir = itemName;
-      }
-    } else {
-      uint32_t fileIndex;
-      if (hasCRCs) {
-        auto analysisName = itemName.substr(1);
-        uint32_t crc = FNV_BASIS;
-        for (auto &c : analysisName) {
-          crc = (crc ^ toupper(c)) * FNV_PRIME & 0xFFFFFFFF;
-        }
-        try {
-          fileIndex = crcToIndex.at(crc);
-        } catch (std::out_of_range error) {
-          logError(
-              std::format("CRC 0x{:<8X} doesn't correspond to a file", crc));
-          throw 1;
-        }
-      } else {
-        // Extract current file
-        fileIndex = fileID;
-      }
-      /*
-      File info table items are 16 bytes long.
+size_t streamEntryToFile(const DatIndex &index, uint32_t item,
+                         const std::filesystem::path &output,
+                         ExtractStats *stats, unsigned worker) {
+  auto info = index.fileInfo(item);
+  OutputFile file;
+  bool ok = file.open(output, info.unpackedSize) == ttError::none;
+  size_t written = 0;
+  if (ok) {
+    written = streamEntry(
+        index, item,
+        [&](std::span<const std::byte> piece) {
+          ok = file.write(piece) == ttError::none;
+          return ok;
+        },
+        stats, worker);
+  }
+  if (file.close() != ttError::none || !ok) {
+    logError(std::format("Error writing destination file {}.", output.string()));
+    throw 1;
+  }
+  if (written != info.unpackedSize) {
+    logWarning(std::format("{}: decoded 0x{:X} of 0x{:X} bytes", index.path(item),
+                           written, info.unpackedSize));
+  }
+  return written;
+}
 
-      4 bytes = absolute offset of data
-          Signature other than -1 shifts left 8 bits
-      4 bytes = size of file (archived)
-      4 bytes = size of file (uncompressed)
-      1 byte  = packed type
-      2 bytes = unknown??
-      1 byte  = byte offset from the given offset
-      */
-      uint32_t offset;
-      uint32_t packedSize;
-      uint32_t unpackedSize;
-      uint32_t packedType;
-      fileIndex = fileInfoOffset + (fileIndex << 4);
-      auto prevOffset = src.tellg();
-      src.seekg(fileIndex);
-      offset = readUint32(src, ENDIAN::little);
-      if (signature != -1) {
-        offset <<= 8;
-      }
-      packedSize = readUint32(src, ENDIAN::little);
-      unpackedSize = readUint32(src, ENDIAN::little);
-      auto nextFour = readUint32(src, ENDIAN::little);
-      packedType = nextFour & 0xFF;
-      offset += nextFour >> 24;
-      isPacked = packedSize != unpackedSize;
-      std::string outputDir = args.outDir + currentDir;
-      std::string outputItem = args.outDir + itemName;
-      std::cout << std::format("{:0>8X}\t{:<8X}\t{:<8X}\t{}\t{}\n", offset,
-                               packedSize, unpackedSize, nameOfAlg(packedType),
-                               outputItem);
-      if (!std::filesystem::is_directory(outputDir)) {
-        std::filesystem::create_directories(outputDir);
-      }
-      std::ofstream dest(outputItem, std::ios::out | std::ios::binary);
-      if (!dest) {
-        logError("Error opening destination file.");
+void extractEntry(const DatIndex &index, const MappedFile &source, uint32_t item,
+                  const cmdlineArgs &args, std::vector<std::byte> &scratch,
+                  ExtractStats *stats, unsigned worker) {
+  auto begin = stats ? ExtractStats::clock::now() : ExtractStats::clock::time_point();
+  auto outputItem = index.outputPath(args.outDir, item);
+  auto info = index.fileInfo(item);
+  if ((args.isRaw || info.packedSize == info.unpackedSize) &&
+      index.archive().inBounds(info)) {
+    // Stored bytes go straight from the archive to the output file
+    {
+      ExtractStats::timer timing(stats, worker, statPhase::WRITE);
+      if (copyToFile(source, info.offset, info.packedSize, outputItem) !=
+          ttError::none) {
+        logError(std::format("Error writing destination file {}.", outputItem.string()));
         throw 1;
       }
-      src.seekg(offset);
-      if (!args.isRaw && isPacked) {
-        if (packedType == 2) {
-          unlz2k(src, dest, packedSize, unpackedSize);
-        } else {
-          logWarning(std::format("Unknown packed type {}, unpacking raw file",
-                                 packedType));
-          writeToDest(src, dest, packedSize);
-        }
-      } else {
-        writeToDest(src, dest, packedSize);
-      }
-      // Return to previous offset
-      src.seekg(prevOffset);
     }
+    if (stats) {
+      stats->addEntry(worker, item, info, info.packedSize,
+                      ExtractStats::clock::now() - begin);
+    }
+    return;
+  }
+  if (!args.isRaw && info.packedType == 2 &&
+      info.unpackedSize >= streamDecodeThreshold &&
+      index.archive().inBounds(info)) {
+    // Too big to be worth a buffer of its own; the scratch buffer would keep
+    // the memory for the rest of the run
+    auto written = streamEntryToFile(index, item, outputItem, stats, worker);
+    if (stats) {
+      stats->addEntry(worker, item, info, written,
+                      ExtractStats::clock::now() - begin);
+    }
+    return;
+  }
+  std::span<const std::byte> data;
+  {
+    ExtractStats::timer timing(stats, worker, statPhase::DECODE);
+    data = decodeEntry(index, item, args.isRaw, scratch);
+  }
+  {
+    ExtractStats::timer timing(stats, worker, statPhase::WRITE);
+    if (writeWholeFile(outputItem, data) != ttError::none) {
+      logError(std::format("Error writing destination file {}.", outputItem.string()));
+      throw 1;
+    }
+  }
+  if (stats) {
+    stats->addEntry(worker, item, info, data.size(),
+                    ExtractStats::clock::now() - begin);
+  }
+}
+
+PathFilter makeFilter(const cmdlineArgs &args) {
+  PathFilter filter;
+  try {
+    for (auto &pattern : args.includes) {
+      filter.include(pattern);
+    }
+    for (auto &pattern : args.excludes) {
+      filter.exclude(pattern);
+    }
+  } catch (const std::regex_error &error) {
+    logError(std::format("Invalid pattern: {}", error.what()));
+    throw 1;
+  }
+  return filter;
+}
+
+void checkError(ttError error, const std::string &detail) {
+  if (error != ttError::none) {
+    logError(detail.empty() ? describe(error) : detail);
+    throw 1;
   }
 }
 
-void writeToDest(std::ifstream &src, std::ofstream &dest, size_t numBytes) {
-  while (numBytes > 0) {
-    size_t toWrite = numBytes < 0x100000 ? numBytes : 0x100000;
-    src.read(outfileBuffer, toWrite);
-    dest.write(outfileBuffer, toWrite);
-    numBytes -= toWrite;
-  }
-}
\ No newline at end of file
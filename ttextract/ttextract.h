@@ -1,15 +1,26 @@
 #ifndef TTEXTRACT_H
 #define TTEXTRACT_H
+#include "include/tterror.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
 #include <string>
 #include <fstream>
 #include <istream>
+#include <span>
+#include <utility>
+#include <vector>
 
-enum class argType { HELP, UNPACK, SIZE, PACKED, ALG, RAW, DIRECTORY, OUTFILE };
+enum class argType { HELP, UNPACK, SIZE, PACKED, ALG, RAW, DIRECTORY, OUTFILE, BENCH, JOBS, LIST, JSON, INCLUDE, EXCLUDE, TOSTDOUT, TAR, INCREMENTAL, STATS, VERIFY, PACK, SIGNATURE, LEVEL, DIFF, DEDUPE, DEDUPECONTENT };
 
 enum class algType { UNSPECIFIED, NONE, LZ2K };
 
 struct cmdlineArgs {
     std::string_view fileName{ "" };
+    // Every archive of a batch, from the command line and response files;
+    // empty unless there's more than one
+    std::vector<std::string> fileNames;
     bool isArchive{ true };
     bool isUnpack{ false };
     bool isRaw{ false };
@@ -18,16 +29,95 @@ struct cmdlineArgs {
     algType alg{ algType::UNSPECIFIED };
     std::string outDir{ "" };
     std::string outName{ "" };
+    int benchRuns{ 0 };
+    unsigned jobs{ 1 };
+    bool isList{ false };
+    bool isJson{ false };
+    std::vector<std::string> includes;
+    std::vector<std::string> excludes;
+    bool toStdout{ false };
+    bool isTar{ false };
+    bool isIncremental{ false };
+    bool isStats{ false };
+    bool isVerify{ false };
+    bool isPack{ false };
+    int signature{ -3 };
+    int level{ 5 };
+    // Archive to compare fileName against, empty unless diffing
+    std::string_view diffName{ "" };
+    bool isDedupe{ false };
+    bool isDedupeContent{ false };
+};
+
+// Number of slowest entries --stats reports
+constexpr size_t slowestEntries = 10;
+// LZ2K entries at least this large are decoded to disk a piece at a time
+// instead of into a buffer of their full size
+constexpr size_t streamDecodeThreshold = 0x1000000;
+constexpr size_t streamPieceSize = 0x100000;
+
+constexpr std::string nameOfAlg(int packedType) {
+    switch (packedType) {
+    case 0:
+        return "----";
+    case 2:
+        return "LZ2K";
+    default:
+        return "????";
+    }
+}
+
+class DatIndex;
+class ExtractStats;
+class MappedFile;
+class PathFilter;
+class ThreadPool;
+struct manifestRecord;
+
+// Entries to extract split into those written from the archive and copies
+// of them, as (copy, original) items, that become links to the original
+struct dedupePlan {
+    std::vector<uint32_t> unique;
+    std::vector<std::pair<uint32_t, uint32_t>> copies;
 };
 
 cmdlineArgs parseArgs(int argc, char *argv[]);
 
+std::string stripExt(std::string fileName);
 void printHelpMessage();
 void logWarning(std::string message);
 void logError(std::string message);
+// Log and throw 1 unless error is ttError::none
+void checkError(ttError error, const std::string& detail);
 
-void handleFPK(std::ifstream& in, size_t fileSize, cmdlineArgs &args);
-void handleDAT(std::ifstream& in, size_t fileSize, cmdlineArgs &args, unsigned int firstWord);
-void writeToDest(std::ifstream& src, std::ofstream& dest, size_t numBytes);
+int handleUnpack(std::span<const std::byte> src, cmdlineArgs &args);
+void benchmarkUnlz2k(std::span<const std::byte> packed, std::span<std::byte> unpacked, int runs);
+void handleFPK(std::span<const std::byte> src);
+void handleDAT(const MappedFile& in, cmdlineArgs &args);
+// Extract the validated index of in to args.outDir on pool: the entry
+// listing, output directories, file order decoding, --dedupe, --incremental
+// and --stats. Returns the number of entries extracted.
+size_t extractDAT(const MappedFile& in, const DatIndex& index, const cmdlineArgs& args, ThreadPool& pool, ExtractStats* stats);
+void handleBatch(const cmdlineArgs& args);
+void handlePack(const cmdlineArgs& args);
+void handleDiff(const cmdlineArgs& args);
+// Group pending entries that point at the same data in the archive, and with
+// byContent also those whose data is identical at different offsets
+dedupePlan planDedupe(const DatIndex& index, const std::vector<uint32_t>& pending, bool byContent, ThreadPool& pool);
+manifestRecord manifestRecordFor(const DatIndex& index, uint32_t item, const manifestRecord& output);
+std::span<const std::byte> decodeEntry(const DatIndex& index, uint32_t item, bool isRaw, std::vector<std::byte>& scratch);
+// Decode a large LZ2K entry a piece at a time, handing each piece to write
+// until it returns false. Returns the number of bytes written.
+size_t streamEntry(const DatIndex& index, uint32_t item, const std::function<bool(std::span<const std::byte>)>& write, ExtractStats* stats, unsigned worker);
+size_t streamEntryToFile(const DatIndex& index, uint32_t item, const std::filesystem::path& output, ExtractStats* stats, unsigned worker);
+// Run body for every index of items on the workers of pool, in the order of
+// the entries' data in source, which is read ahead of the workers
+void forEachInFileOrder(ThreadPool& pool, const MappedFile& source, const DatIndex& index, const std::vector<uint32_t>& items, const std::function<void(size_t, unsigned)>& body);
+void extractEntry(const DatIndex& index, const MappedFile& source, uint32_t item, const cmdlineArgs& args, std::vector<std::byte>& scratch, ExtractStats* stats, unsigned worker);
+PathFilter makeFilter(const cmdlineArgs& args);
+void listDAT(const DatIndex& index, const cmdlineArgs& args);
+void streamDAT(const DatIndex& index, const cmdlineArgs& args, ExtractStats* stats);
+void verifyDAT(const DatIndex& index, const cmdlineArgs& args, ExtractStats* stats);
+std::string jsonEscape(std::string_view text);
 
 #endif // TTEXTRACT_H
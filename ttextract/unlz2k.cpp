@@ -0,0 +1,617 @@
+// unlz2k.cpp : In-memory and streaming LZ2K decoders.
+//
+// The bit stream follows Haruhiko Okumura's ar002 (the LHA -lh5- format):
+// blocks of Huffman coded literals/match lengths and match positions, each
+// block preceded by its code length tables.
+
+#include "include/unlz2k.h"
+#include "include/filereading.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <vector>
+
+namespace {
+
+constexpr int DICBIT = 13;
+constexpr int MAXMATCH = 256;
+constexpr int THRESHOLD = 3;
+// Literals 0-255 plus match lengths THRESHOLD..MAXMATCH
+constexpr int NC = UINT8_MAX + MAXMATCH + 2 - THRESHOLD;
+constexpr int CBIT = 9;
+constexpr int CODE_BIT = 16;
+// Position codes (bit length of the match distance)
+constexpr int NP = DICBIT + 1;
+// Code length codes
+constexpr int NT = CODE_BIT + 3;
+constexpr int PBIT = 4;
+constexpr int TBIT = 5;
+constexpr int NPT = NT;
+constexpr int CTABLEBITS = 12;
+constexpr int PTTABLEBITS = 8;
+
+constexpr uint32_t chunkMagic = 0x4B325A4C; // "LZ2K"
+constexpr size_t chunkHeaderSize = 12;
+
+// Most input a single decode step can consume: a block header with every
+// code length at its longest, plus one match. Lz2kStream only steps with
+// this much input buffered, unless it has the rest of the chunk.
+constexpr size_t stepInputMargin = 0x800;
+
+// MSB-first bit reader. Reads past the end of the input yield zero bits, which
+// is how the reference decoder behaves; exhausted() reports when that
+// happened.
+class bitReader {
+public:
+  explicit bitReader(std::span<const std::byte> src)
+      : pos(reinterpret_cast<const uint8_t *>(src.data())),
+        end(pos + src.size()) {
+    refill();
+  }
+
+  // Top n bits (n <= 16) without consuming them.
+  [[nodiscard]] uint32_t peek(int n) const {
+    return static_cast<uint32_t>(bitBuf >> (64 - n));
+  }
+
+  void skip(int n) {
+    bitBuf <<= n;
+    bitCount -= n;
+    if (bitCount < 32) {
+      refill();
+    }
+  }
+
+  [[nodiscard]] uint32_t get(int n) {
+    if (n == 0) {
+      return 0;
+    }
+    uint32_t bits = peek(n);
+    skip(n);
+    return bits;
+  }
+
+  // Raw access to the next 16 bits for the unary length prefix.
+  [[nodiscard]] uint32_t window() const { return peek(16); }
+
+  [[nodiscard]] bool exhausted() const {
+    return padBits > static_cast<size_t>(bitCount);
+  }
+
+  // First input byte not yet loaded into the bit buffer, and how many follow
+  [[nodiscard]] const std::byte *next() const {
+    return reinterpret_cast<const std::byte *>(pos);
+  }
+  [[nodiscard]] size_t unread() const { return static_cast<size_t>(end - pos); }
+
+  // Continue from a moved or extended copy of the input, where next is the
+  // copy of next(). Only valid while no padding has been read.
+  void rebind(const std::byte *next, const std::byte *newEnd) {
+    pos = reinterpret_cast<const uint8_t *>(next);
+    end = reinterpret_cast<const uint8_t *>(newEnd);
+  }
+
+private:
+  void refill() {
+    while (bitCount <= 56) {
+      uint64_t byte = 0;
+      if (pos < end) {
+        byte = *pos++;
+      } else {
+        padBits += 8;
+      }
+      bitBuf |= byte << (56 - bitCount);
+      bitCount += 8;
+    }
+  }
+
+  const uint8_t *pos;
+  const uint8_t *end;
+  uint64_t bitBuf{0};
+  int bitCount{0};
+  size_t padBits{0};
+};
+
+class decoder {
+public:
+  explicit decoder(std::span<const std::byte> src) : bits(src) {}
+
+  size_t decode(std::span<std::byte> dest) {
+    auto *out = reinterpret_cast<uint8_t *>(dest.data());
+    size_t total = dest.size();
+    size_t written = 0;
+    while (written < total) {
+      int c = decodeC();
+      if (c < 0) {
+        break;
+      }
+      if (c <= UINT8_MAX) {
+        out[written++] = static_cast<uint8_t>(c);
+        continue;
+      }
+      size_t length = c - (UINT8_MAX + 1 - THRESHOLD);
+      int p = decodeP();
+      if (p < 0) {
+        break;
+      }
+      size_t distance = static_cast<size_t>(p) + 1;
+      if (distance > written) {
+        break;
+      }
+      if (length > total - written) {
+        length = total - written;
+      }
+      uint8_t *to = out + written;
+      const uint8_t *from = to - distance;
+      if (distance >= length) {
+        std::memcpy(to, from, length);
+      } else {
+        for (size_t i = 0; i < length; ++i) {
+          to[i] = from[i];
+        }
+      }
+      written += length;
+    }
+    return written;
+  }
+
+  // Next literal/length symbol, or -1 on corrupt input.
+  int decodeC() {
+    if (blockSize == 0) {
+      blockSize = bits.get(16);
+      if (blockSize == 0 || bits.exhausted() || !readPtLen(NT, TBIT, 3) ||
+          !readCLen() || !readPtLen(NP, PBIT, -1)) {
+        return -1;
+      }
+    }
+    blockSize--;
+    int j = cTable[bits.peek(CTABLEBITS)];
+    if (j >= NC) {
+      uint32_t window = bits.window();
+      uint32_t mask = 1u << (16 - 1 - CTABLEBITS);
+      do {
+        j = (window & mask) ? right[j] : left[j];
+        mask >>= 1;
+      } while (j >= NC && mask);
+      if (j >= NC) {
+        return -1;
+      }
+    }
+    bits.skip(cLen[j]);
+    if (bits.exhausted()) {
+      return -1;
+    }
+    return j;
+  }
+
+  // Next match distance minus one, or -1 on corrupt input.
+  int decodeP() {
+    int j = ptTable[bits.peek(PTTABLEBITS)];
+    if (j >= NP) {
+      uint32_t window = bits.window();
+      uint32_t mask = 1u << (16 - 1 - PTTABLEBITS);
+      do {
+        j = (window & mask) ? right[j] : left[j];
+        mask >>= 1;
+      } while (j >= NP && mask);
+      if (j >= NP) {
+        return -1;
+      }
+    }
+    bits.skip(ptLen[j]);
+    if (j != 0) {
+      j = (1 << (j - 1)) + bits.get(j - 1);
+    }
+    if (bits.exhausted()) {
+      return -1;
+    }
+    return j;
+  }
+
+  [[nodiscard]] bitReader &reader() { return bits; }
+
+private:
+  // Build a lookup table of tableBits for the canonical code described by
+  // bitLen, with longer codes continuing into the left/right trees. Returns
+  // false if the lengths don't describe a complete code.
+  bool makeTable(int nchar, const uint8_t *bitLen, int tableBits,
+                 uint16_t *table) {
+    uint32_t count[17]{}, weight[17]{}, start[18]{};
+    for (int i = 0; i < nchar; ++i) {
+      count[bitLen[i]]++;
+    }
+    for (int i = 1; i <= 16; ++i) {
+      start[i + 1] = start[i] + (count[i] << (16 - i));
+    }
+    if (start[17] != 1u << 16) {
+      return false;
+    }
+    int jutBits = 16 - tableBits;
+    int i = 1;
+    for (; i <= tableBits; ++i) {
+      start[i] >>= jutBits;
+      weight[i] = 1u << (tableBits - i);
+    }
+    for (; i <= 16; ++i) {
+      weight[i] = 1u << (16 - i);
+    }
+    uint32_t tableSize = 1u << tableBits;
+    for (uint32_t k = start[tableBits + 1] >> jutBits; k < tableSize; ++k) {
+      table[k] = 0;
+    }
+    int avail = nchar;
+    uint32_t mask = 1u << (15 - tableBits);
+    for (int ch = 0; ch < nchar; ++ch) {
+      int len = bitLen[ch];
+      if (len == 0) {
+        continue;
+      }
+      uint32_t nextCode = start[len] + weight[len];
+      if (len <= tableBits) {
+        for (uint32_t k = start[len]; k < nextCode; ++k) {
+          table[k] = static_cast<uint16_t>(ch);
+        }
+      } else {
+        uint32_t k = start[len];
+        uint16_t *p = &table[k >> jutBits];
+        for (int n = len - tableBits; n != 0; --n) {
+          if (*p == 0) {
+            if (avail >= 2 * NC - 1) {
+              return false;
+            }
+            left[avail] = right[avail] = 0;
+            *p = static_cast<uint16_t>(avail++);
+          }
+          p = (k & mask) ? &right[*p] : &left[*p];
+          k <<= 1;
+        }
+        *p = static_cast<uint16_t>(ch);
+      }
+      start[len] = nextCode;
+    }
+    return true;
+  }
+
+  bool readPtLen(int nn, int nbit, int iSpecial) {
+    int n = bits.get(nbit);
+    if (n == 0) {
+      uint16_t c = static_cast<uint16_t>(bits.get(nbit));
+      if (c >= nn) {
+        return false;
+      }
+      std::memset(ptLen, 0, nn);
+      for (auto &entry : ptTable) {
+        entry = c;
+      }
+      return true;
+    }
+    if (n > nn) {
+      return false;
+    }
+    int i = 0;
+    while (i < n) {
+      int c = bits.peek(3);
+      if (c == 7) {
+        uint32_t window = bits.window();
+        uint32_t mask = 1u << (16 - 1 - 3);
+        while (mask & window) {
+          mask >>= 1;
+          c++;
+        }
+        if (c > 16) {
+          return false;
+        }
+      }
+      bits.skip(c < 7 ? 3 : c - 3);
+      ptLen[i++] = static_cast<uint8_t>(c);
+      if (i == iSpecial) {
+        int zeroes = bits.get(2);
+        if (i + zeroes > nn) {
+          return false;
+        }
+        while (zeroes-- > 0) {
+          ptLen[i++] = 0;
+        }
+      }
+    }
+    while (i < nn) {
+      ptLen[i++] = 0;
+    }
+    return makeTable(nn, ptLen, PTTABLEBITS, ptTable);
+  }
+
+  bool readCLen() {
+    int n = bits.get(CBIT);
+    if (n == 0) {
+      uint16_t c = static_cast<uint16_t>(bits.get(CBIT));
+      if (c >= NC) {
+        return false;
+      }
+      std::memset(cLen, 0, NC);
+      for (auto &entry : cTable) {
+        entry = c;
+      }
+      return true;
+    }
+    if (n > NC) {
+      return false;
+    }
+    int i = 0;
+    while (i < n) {
+      int c = ptTable[bits.peek(PTTABLEBITS)];
+      if (c >= NT) {
+        uint32_t window = bits.window();
+        uint32_t mask = 1u << (16 - 1 - PTTABLEBITS);
+        do {
+          c = (window & mask) ? right[c] : left[c];
+          mask >>= 1;
+        } while (c >= NT && mask);
+        if (c >= NT) {
+          return false;
+        }
+      }
+      bits.skip(ptLen[c]);
+      if (c <= 2) {
+        int zeroes;
+        if (c == 0) {
+          zeroes = 1;
+        } else if (c == 1) {
+          zeroes = bits.get(4) + 3;
+        } else {
+          zeroes = bits.get(CBIT) + 20;
+        }
+        if (i + zeroes > NC) {
+          return false;
+        }
+        while (zeroes-- > 0) {
+          cLen[i++] = 0;
+        }
+      } else {
+        cLen[i++] = static_cast<uint8_t>(c - 2);
+      }
+    }
+    while (i < NC) {
+      cLen[i++] = 0;
+    }
+    return makeTable(NC, cLen, CTABLEBITS, cTable);
+  }
+
+  bitReader bits;
+  uint32_t blockSize{0};
+  uint16_t left[2 * NC - 1]{};
+  uint16_t right[2 * NC - 1]{};
+  uint8_t cLen[NC]{};
+  uint8_t ptLen[NPT]{};
+  uint16_t cTable[1 << CTABLEBITS]{};
+  uint16_t ptTable[1 << PTTABLEBITS]{};
+};
+
+bool hasChunkHeader(std::span<const std::byte> src) {
+  return src.size() >= chunkHeaderSize &&
+         readUint32(src, 0, ENDIAN::little) == chunkMagic;
+}
+
+} // namespace
+
+size_t unlz2k(std::span<const std::byte> src, std::span<std::byte> dest) {
+  if (!hasChunkHeader(src)) {
+    return decoder(src).decode(dest);
+  }
+  size_t written = 0;
+  while (written < dest.size() && hasChunkHeader(src)) {
+    size_t unpacked = readUint32(src, 4, ENDIAN::little);
+    size_t packed = readUint32(src, 8, ENDIAN::little);
+    src = src.subspan(chunkHeaderSize);
+    if (packed > src.size() || unpacked > dest.size() - written) {
+      break;
+    }
+    size_t chunkWritten =
+        decoder(src.first(packed)).decode(dest.subspan(written, unpacked));
+    written += chunkWritten;
+    if (chunkWritten != unpacked) {
+      break;
+    }
+    src = src.subspan(packed);
+  }
+  return written;
+}
+
+size_t lz2kUnpackedSize(std::span<const std::byte> src) {
+  size_t total = 0;
+  while (hasChunkHeader(src)) {
+    size_t packed = readUint32(src, 8, ENDIAN::little);
+    total += readUint32(src, 4, ENDIAN::little);
+    if (packed > src.size() - chunkHeaderSize) {
+      break;
+    }
+    src = src.subspan(chunkHeaderSize + packed);
+  }
+  return total;
+}
+
+namespace {
+
+// Output ring for Lz2kStream: the window plus decoded bytes waiting to be
+// drained. Must exceed the window and a maximal match.
+constexpr size_t ringBits = 15;
+constexpr size_t ringSize = size_t{1} << ringBits;
+constexpr size_t ringMask = ringSize - 1;
+static_assert(ringSize > (size_t{1} << DICBIT) + MAXMATCH);
+
+} // namespace
+
+struct Lz2kStream::state {
+  enum class stage { header, body, done, failed };
+
+  // Decode from the current chunk until it ends, the ring is full or more
+  // input is needed. Returns false if nothing could be done.
+  bool decodeChunk() {
+    auto &bits = chunk->reader();
+    bool haveAll = lastFed || chunkEnd <= base + input.size();
+    size_t before = produced;
+    while (chunkDone < chunkSize && produced - drained + MAXMATCH <= ringSize) {
+      if (!haveAll && bits.unread() < stepInputMargin) {
+        starved = true;
+        break;
+      }
+      int c = chunk->decodeC();
+      if (c < 0) {
+        at = stage::failed;
+        return true;
+      }
+      if (c <= UINT8_MAX) {
+        ring[produced++ & ringMask] = static_cast<uint8_t>(c);
+        chunkDone++;
+        continue;
+      }
+      size_t length = c - (UINT8_MAX + 1 - THRESHOLD);
+      int p = chunk->decodeP();
+      size_t distance = static_cast<size_t>(p) + 1;
+      if (p < 0 || distance > chunkDone) {
+        at = stage::failed;
+        return true;
+      }
+      length = std::min(length, chunkSize - chunkDone);
+      for (size_t i = 0; i < length; ++i, ++produced) {
+        ring[produced & ringMask] = ring[(produced - distance) & ringMask];
+      }
+      chunkDone += length;
+    }
+    if (chunkDone == chunkSize) {
+      chunk.reset();
+      at = chunked ? stage::header : stage::done;
+      headerAt = chunkEnd;
+      return true;
+    }
+    return produced != before;
+  }
+
+  // Start the next chunk once its header (if any) and enough of its data are
+  // queued; the decoder must never read past queued input it can't take
+  // back. Returns false if more input is needed.
+  bool startChunk() {
+    if (chunked && produced == unpackedSize) {
+      at = stage::done;
+      return true;
+    }
+    size_t queuedEnd = base + input.size();
+    auto rest = std::span(input).subspan(std::min(headerAt, queuedEnd) - base);
+    if (!lastFed && rest.size() < chunkHeaderSize) {
+      starved = true;
+      return false;
+    }
+    if (headerAt == 0) {
+      chunked = hasChunkHeader(rest);
+    }
+    size_t dataAt = headerAt;
+    size_t size = unpackedSize;
+    size_t end = SIZE_MAX;
+    if (chunked) {
+      if (!hasChunkHeader(rest) || readUint32(rest, 4, ENDIAN::little) >
+                                       unpackedSize - produced) {
+        at = stage::failed;
+        return true;
+      }
+      size = readUint32(rest, 4, ENDIAN::little);
+      dataAt += chunkHeaderSize;
+      end = dataAt + readUint32(rest, 8, ENDIAN::little);
+      rest = rest.subspan(chunkHeaderSize);
+    }
+    if (!lastFed && end > queuedEnd && rest.size() < stepInputMargin) {
+      starved = true;
+      return false;
+    }
+    headerAt = dataAt;
+    chunkEnd = end;
+    chunkSize = size;
+    chunkDone = 0;
+    chunk.emplace(rest.first(std::min(rest.size(), end - dataAt)));
+    at = stage::body;
+    return true;
+  }
+
+  size_t unpackedSize;
+  stage at{stage::header};
+  bool chunked{false};
+  bool lastFed{false};
+  bool starved{false};
+
+  // Queued input, starting at stream offset base
+  std::vector<std::byte> input;
+  size_t base{0};
+  // Stream offsets of the next chunk header and the end of the current chunk
+  size_t headerAt{0};
+  size_t chunkEnd{0};
+
+  std::optional<decoder> chunk;
+  size_t chunkSize{0};
+  size_t chunkDone{0};
+
+  // Bytes decoded into and drained from the ring over the whole stream
+  size_t produced{0};
+  size_t drained{0};
+  std::array<uint8_t, ringSize> ring{};
+};
+
+Lz2kStream::Lz2kStream(size_t unpackedSize) : impl(std::make_unique<state>()) {
+  impl->unpackedSize = unpackedSize;
+}
+
+Lz2kStream::~Lz2kStream() = default;
+
+void Lz2kStream::feed(std::span<const std::byte> input, bool last) {
+  auto &s = *impl;
+  // Drop input that's already been consumed: everything the decoder has
+  // loaded, or everything before the next header
+  size_t keepFrom = s.chunk ? s.base + static_cast<size_t>(s.chunk->reader().next() -
+                                                         s.input.data())
+                            : std::min(s.headerAt, s.base + s.input.size());
+  s.input.erase(s.input.begin(), s.input.begin() + (keepFrom - s.base));
+  s.base = keepFrom;
+  s.input.insert(s.input.end(), input.begin(), input.end());
+  s.lastFed = s.lastFed || last;
+  s.starved = false;
+  if (s.chunk) {
+    size_t end = std::min(s.base + s.input.size(), s.chunkEnd);
+    s.chunk->reader().rebind(s.input.data(), s.input.data() + (end - s.base));
+  }
+}
+
+size_t Lz2kStream::drain(std::span<std::byte> out) {
+  auto &s = *impl;
+  auto *to = reinterpret_cast<uint8_t *>(out.data());
+  size_t written = 0;
+  while (written < out.size()) {
+    if (size_t pending = s.produced - s.drained) {
+      // Copy out up to the end of the ring, then wrap on the next pass
+      size_t from = s.drained & ringMask;
+      size_t n = std::min({pending, out.size() - written, ringSize - from});
+      std::memcpy(to + written, s.ring.data() + from, n);
+      written += n;
+      s.drained += n;
+      continue;
+    }
+    bool progressed = false;
+    if (s.at == state::stage::header) {
+      progressed = s.startChunk();
+    } else if (s.at == state::stage::body) {
+      progressed = s.decodeChunk();
+    }
+    if (!progressed) {
+      break;
+    }
+  }
+  return written;
+}
+
+bool Lz2kStream::needsInput() const {
+  return impl->starved && !impl->lastFed;
+}
+
+bool Lz2kStream::finished() const {
+  return impl->at == state::stage::done && impl->drained == impl->unpackedSize;
+}
+
+bool Lz2kStream::failed() const { return impl->at == state::stage::failed; }
@@ -0,0 +1,119 @@
+// verify.cpp : Check an archive's tables and data without extracting it.
+
+#include "ttextract.h"
+#include "include/datindex.h"
+#include "include/extractstats.h"
+#include "include/threadpool.h"
+#include "include/unlz2k.h"
+#include <algorithm>
+#include <format>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// A problem found with one item, kept so reports come out in archive order
+// however the workers interleave
+using problem = std::pair<uint32_t, std::string>;
+
+// Check the data of one file entry, decoding it into scratch if it's
+// compressed. Returns an empty string if the entry is intact.
+std::string verifyEntry(const DatIndex &index, uint32_t item,
+                        std::vector<std::byte> &scratch) {
+  auto info = index.fileInfo(item);
+  if (!index.archive().inBounds(info)) {
+    return std::format("data at 0x{:X} (0x{:X} bytes) runs past end of file",
+                       info.offset, info.packedSize);
+  }
+  if (info.packedSize == info.unpackedSize) {
+    return {};
+  }
+  if (info.packedType != 2) {
+    return std::format("unknown packed type {}", info.packedType);
+  }
+  scratch.resize(std::max<size_t>(scratch.size(), info.unpackedSize));
+  auto written = unlz2k(index.archive().payload(info),
+                        std::span(scratch).first(info.unpackedSize));
+  if (written != info.unpackedSize) {
+    return std::format("decoded 0x{:X} of 0x{:X} bytes", written,
+                       info.unpackedSize);
+  }
+  return {};
+}
+
+} // namespace
+
+void verifyDAT(const DatIndex &index, const cmdlineArgs &args,
+               ExtractStats *stats) {
+  const auto &archive = index.archive();
+  const auto &files = index.files();
+  std::vector<problem> problems;
+
+  // Building the index already matched every name against the CRC table.
+  // What it can't see is two names resolving to one file, or files no name
+  // leads to.
+  std::vector<uint32_t> namedBy(archive.numFiles(), datIndexEntry::noFile);
+  for (auto item : files) {
+    auto fileIndex = index.entries()[item].fileIndex;
+    if (namedBy[fileIndex] != datIndexEntry::noFile) {
+      problems.emplace_back(item, std::format("file {} is also named by {}",
+                                              fileIndex,
+                                              index.path(namedBy[fileIndex])));
+    }
+    namedBy[fileIndex] = item;
+  }
+  if (args.includes.empty() && args.excludes.empty()) {
+    auto unnamed = std::count(namedBy.begin(), namedBy.end(),
+                              datIndexEntry::noFile);
+    if (unnamed) {
+      problems.emplace_back(datIndexEntry::noParent,
+                            std::format("{} files in the file table have no name",
+                                        unnamed));
+    }
+  }
+
+  // Decode everything in memory, each worker with its own scratch buffer
+  ThreadPool pool(args.jobs);
+  std::vector<std::vector<std::byte>> scratch(pool.size());
+  std::vector<std::vector<problem>> found(pool.size());
+  pool.parallelFor(files.size(), [&](size_t i, unsigned worker) {
+    auto begin = ExtractStats::clock::now();
+    std::string message;
+    {
+      ExtractStats::timer timing(stats, worker, statPhase::DECODE);
+      message = verifyEntry(index, files[i], scratch[worker]);
+    }
+    if (!message.empty()) {
+      found[worker].emplace_back(files[i], std::move(message));
+    }
+    if (stats) {
+      auto info = index.fileInfo(files[i]);
+      stats->addEntry(worker, files[i], info, info.unpackedSize,
+                      ExtractStats::clock::now() - begin);
+    }
+  });
+  for (auto &list : found) {
+    problems.insert(problems.end(), std::make_move_iterator(list.begin()),
+                    std::make_move_iterator(list.end()));
+  }
+  std::sort(problems.begin(), problems.end());
+
+  for (auto &[item, message] : problems) {
+    if (item == datIndexEntry::noParent) {
+      logError(message);
+    } else {
+      logError(std::format("{}: {}", index.path(item), message));
+    }
+  }
+  if (stats) {
+    stats->print(std::cout, index, args.isJson);
+  }
+  if (!problems.empty()) {
+    logError(std::format("{} problems found in {} files", problems.size(),
+                         files.size()));
+    throw 1;
+  }
+  std::cout << std::format("Verified {} files, no problems found\n", files.size());
+}
@@ -0,0 +1,75 @@
+// fuzz_lz2k.cpp : libFuzzer harness for the LZ2K decoders.
+//
+// Decodes arbitrary bytes with unlz2k() in one piece and with Lz2kStream in
+// pieces whose sizes come from the input, and checks the two agree whenever
+// both decode everything. Any crash, hang, sanitizer report or mismatch is a
+// bug; corrupt input decoding short is not. fuzz_lz2k.vcxproj builds it with
+// MSVC; with clang,
+//   clang++ -std=c++20 -g -O1 -fsanitize=fuzzer,address,undefined
+//       fuzz_lz2k.cpp ../ttextract/unlz2k.cpp -o fuzz_lz2k
+//   ./fuzz_lz2k corpus/
+// Seed the corpus with entries compressed by --pack.
+
+#include "../ttextract/include/unlz2k.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <span>
+#include <vector>
+
+namespace {
+
+// Input layout: unpacked size (one byte of KB, one of extra bytes), feed
+// piece size less one, then the packed data
+constexpr size_t prefixSize = 3;
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (size < prefixSize) {
+    return 0;
+  }
+  // Up to 255 KB, so a short input can still ask for a long output
+  size_t unpackedSize = (size_t{data[0]} << 10) | data[1];
+  size_t pieceSize = size_t{data[2]} + 1;
+  std::span<const std::byte> packed(reinterpret_cast<const std::byte *>(data) + prefixSize,
+                                    size - prefixSize);
+
+  std::vector<std::byte> whole(unpackedSize);
+  auto written = unlz2k(packed, whole);
+  if (written > unpackedSize) {
+    std::abort();
+  }
+  (void)lz2kUnpackedSize(packed);
+
+  // Same input in small pieces, drained through an odd sized buffer so
+  // pieces and output never line up
+  Lz2kStream stream(unpackedSize);
+  std::vector<std::byte> streamed;
+  std::byte out[1021];
+  size_t fed = 0;
+  while (!stream.finished() && !stream.failed()) {
+    auto got = stream.drain(out);
+    streamed.insert(streamed.end(), out, out + got);
+    if (streamed.size() > unpackedSize) {
+      std::abort();
+    }
+    if (stream.needsInput()) {
+      if (fed == packed.size()) {
+        break;
+      }
+      auto piece = std::min(pieceSize, packed.size() - fed);
+      stream.feed(packed.subspan(fed, piece), fed + piece == packed.size());
+      fed += piece;
+    } else if (got == 0) {
+      break;
+    }
+  }
+
+  if (written == unpackedSize && stream.finished() &&
+      !std::equal(whole.begin(), whole.end(), streamed.begin(), streamed.end())) {
+    std::abort();
+  }
+  return 0;
+}
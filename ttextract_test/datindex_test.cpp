@@ -0,0 +1,101 @@
+// datindex_test.cpp : Tests for resolving and validating the name tree.
+
+#include "../ttextract/include/archiveview.h"
+#include "../ttextract/include/datindex.h"
+#include "../ttextract/include/datwriter.h"
+#include "test.h"
+#include <algorithm>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const std::vector<std::string> testPaths{
+    "\\LEVELS\\CITY\\CITY.GSC", "\\LEVELS\\CITY\\XX", "\\LEVELS\\FOREST.GSC",
+    "\\CHARS\\Y1Y.TXT", "\\TOP.TXT"};
+
+// Without CRCs, so names can be patched without the lookup rejecting them
+std::string writeArchive() {
+  std::stringstream stream;
+  DatWriter writer(stream, -1, false);
+  std::vector<std::byte> data(4, std::byte('d'));
+  for (auto &path : testPaths) {
+    CHECK(writer.add(path, data, 4, 0) == ttError::none);
+  }
+  CHECK(writer.finish() == ttError::none);
+  return stream.str();
+}
+
+// Replace the only occurrence of from in the name data with to, of the same
+// length
+std::string patchName(std::string text, const std::string &from,
+                      const std::string &to) {
+  auto at = text.find(from + '\0');
+  CHECK(at != std::string::npos);
+  text.replace(at, to.size(), to);
+  return text;
+}
+
+ttError resolve(const std::string &text, std::string *detail = nullptr) {
+  ArchiveView view;
+  CHECK(view.parse(std::as_bytes(std::span(text))) == ttError::none);
+  DatIndex index;
+  auto error = index.build(view, nullptr, detail);
+  return error != ttError::none ? error : index.validate(detail);
+}
+
+} // namespace
+
+TEST_CASE(resolvesPaths) {
+  auto text = writeArchive();
+  ArchiveView view;
+  CHECK(view.parse(std::as_bytes(std::span(text))) == ttError::none);
+  DatIndex index;
+  CHECK(index.build(view) == ttError::none);
+  CHECK(index.validate() == ttError::none);
+  CHECK(index.files().size() == testPaths.size());
+
+  std::set<std::string> paths;
+  for (auto item : index.files()) {
+    CHECK(!index.isFolder(item));
+    auto path = index.path(item);
+    paths.insert(path);
+    // The output path is the archive path under outDir
+    std::string relative = path.substr(1);
+    std::replace(relative.begin(), relative.end(), '\\', '/');
+    CHECK(index.outputPath("out", item) == std::filesystem::path("out") / relative);
+    CHECK(index.fileInfo(item).unpackedSize == 4);
+  }
+  CHECK(paths == std::set<std::string>(testPaths.begin(), testPaths.end()));
+}
+
+TEST_CASE(rejectsUnsafeNames) {
+  auto text = writeArchive();
+  std::string detail;
+  CHECK(resolve(patchName(text, "XX", "..")) == ttError::badNameTree);
+  CHECK(resolve(patchName(text, "Y1Y.TXT", "Y/Y.TXT")) == ttError::badNameTree);
+  CHECK(resolve(patchName(text, "Y1Y.TXT", "Y\\Y.TXT")) == ttError::badNameTree);
+  CHECK(resolve(patchName(text, "Y1Y.TXT", "C:Y.TXT"), &detail) == ttError::badNameTree);
+  CHECK(detail.find("isn't a valid file name") != std::string::npos);
+  // A name that only looks like one of those is fine
+  CHECK(resolve(patchName(text, "XX", ".X")) == ttError::none);
+}
+
+TEST_CASE(rejectsForwardPathReferences) {
+  auto text = writeArchive();
+  ArchiveView view;
+  CHECK(view.parse(std::as_bytes(std::span(text))) == ttError::none);
+  // Point the last item's path at itself, then at a later item
+  auto last = view.numNames() - 1;
+  auto at = view.nameInfoOffset() + last * size_t{8} + 2;
+  for (uint32_t target : {last, last + 1}) {
+    auto patched = text;
+    patched[at] = static_cast<char>(target & 0xFF);
+    patched[at + 1] = static_cast<char>(target >> 8);
+    std::string detail;
+    CHECK(resolve(patched, &detail) == ttError::badNameTree);
+    CHECK(detail.find("later name") != std::string::npos);
+  }
+}
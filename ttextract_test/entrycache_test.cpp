@@ -0,0 +1,132 @@
+// entrycache_test.cpp : Tests for Archive reads through an EntryCache.
+
+#include "../ttextract/include/datwriter.h"
+#include "../ttextract/include/entrycache.h"
+#include "../ttextract/include/lz2k.h"
+#include "../ttextract/include/ttarchive.h"
+#include "test.h"
+#include <algorithm>
+#include <sstream>
+
+namespace {
+
+std::vector<std::byte> pattern(size_t size, unsigned seed) {
+  std::vector<std::byte> data(size);
+  for (size_t i = 0; i < size; i++) {
+    data[i] = std::byte((i / 7 + seed) % 13 + 'A');
+  }
+  return data;
+}
+
+// Two LZ2K entries of 4 KiB and a stored one
+struct testArchive {
+  std::vector<std::byte> a = pattern(4096, 1);
+  std::vector<std::byte> b = pattern(4096, 2);
+  std::vector<std::byte> c = pattern(100, 3);
+  std::vector<std::byte> bytes;
+
+  testArchive() {
+    std::stringstream stream;
+    DatWriter writer(stream, -3);
+    std::vector<std::byte> packed;
+    lz2k(a, packed);
+    CHECK(writer.add("\\DIR\\A.TXT", packed, uint32_t(a.size()), 2) == ttError::none);
+    packed.clear();
+    lz2k(b, packed);
+    CHECK(writer.add("\\DIR\\B.TXT", packed, uint32_t(b.size()), 2) == ttError::none);
+    CHECK(writer.add("\\C.TXT", c, uint32_t(c.size()), 0) == ttError::none);
+    CHECK(writer.finish() == ttError::none);
+    auto text = stream.str();
+    bytes.resize(text.size());
+    std::transform(text.begin(), text.end(), bytes.begin(),
+                   [](char ch) { return std::byte(ch); });
+  }
+};
+
+bool same(const entryData &data, const std::vector<std::byte> &expected) {
+  return std::ranges::equal(data.bytes, expected);
+}
+
+} // namespace
+
+TEST_CASE(readWithoutCache) {
+  testArchive source;
+  std::unique_ptr<Archive> archive;
+  CHECK(Archive::open(source.bytes, archive) == ttError::none);
+  if (!archive) {
+    return;
+  }
+  entryData data;
+  CHECK(archive->read(*archive->find("dir/a.txt"), data) == ttError::none);
+  CHECK(same(data, source.a));
+  CHECK(data.holder);
+  CHECK(archive->read(*archive->find("C.TXT"), data) == ttError::none);
+  CHECK(same(data, source.c));
+  CHECK(!data.holder);
+}
+
+TEST_CASE(cacheHitsAndEvicts) {
+  testArchive source;
+  // Room for one decoded entry. Declared first, as it must outlive the Archive.
+  EntryCache cache(6000, 1);
+  std::unique_ptr<Archive> archive;
+  CHECK(Archive::open(source.bytes, archive) == ttError::none);
+  if (!archive) {
+    return;
+  }
+  archive->useCache(&cache);
+  const auto &a = *archive->find("\\DIR\\A.TXT");
+  const auto &b = *archive->find("\\DIR\\B.TXT");
+
+  entryData first, second;
+  CHECK(archive->read(a, first) == ttError::none);
+  CHECK(archive->read(a, second) == ttError::none);
+  CHECK(same(first, source.a));
+  CHECK(first.holder == second.holder);
+  auto stats = cache.stats();
+  CHECK(stats.misses == 1);
+  CHECK(stats.hits == 1);
+  CHECK(stats.entries == 1);
+
+  CHECK(archive->read(b, second) == ttError::none);
+  CHECK(same(second, source.b));
+  stats = cache.stats();
+  CHECK(stats.evictions == 1);
+  CHECK(stats.entries == 1);
+  // Evicted data stays valid for whoever still holds it
+  CHECK(same(first, source.a));
+
+  // Stored entries bypass the cache
+  CHECK(archive->read(*archive->find("C.TXT"), second) == ttError::none);
+  CHECK(same(second, source.c));
+  CHECK(cache.stats().misses == 2);
+}
+
+TEST_CASE(closingArchiveForgetsEntries) {
+  testArchive source;
+  EntryCache cache(1 << 20);
+  std::unique_ptr<Archive> archive, other;
+  CHECK(Archive::open(source.bytes, archive) == ttError::none);
+  CHECK(Archive::open(source.bytes, other) == ttError::none);
+  if (!archive || !other) {
+    return;
+  }
+  archive->useCache(&cache);
+  other->useCache(&cache);
+  entryData data;
+  CHECK(archive->read(*archive->find("DIR\\A.TXT"), data) == ttError::none);
+  CHECK(archive->read(*archive->find("DIR\\B.TXT"), data) == ttError::none);
+  CHECK(other->read(*other->find("DIR\\A.TXT"), data) == ttError::none);
+  CHECK(cache.stats().entries == 3);
+
+  archive.reset();
+  auto stats = cache.stats();
+  CHECK(stats.entries == 1);
+  CHECK(stats.bytes == source.a.size());
+
+  other->useCache(nullptr);
+  CHECK(cache.stats().entries == 0);
+  CHECK(other->read(*other->find("DIR\\A.TXT"), data) == ttError::none);
+  CHECK(same(data, source.a));
+  CHECK(cache.stats().misses == 3);
+}
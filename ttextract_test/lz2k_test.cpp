@@ -0,0 +1,153 @@
+// lz2k_test.cpp : Round trips through the LZ2K encoder and both decoders.
+
+#include "../ttextract/include/lz2k.h"
+#include "../ttextract/include/unlz2k.h"
+#include "test.h"
+#include <algorithm>
+#include <cstdint>
+#include <random>
+
+namespace {
+
+constexpr size_t window = 8192;
+
+std::vector<std::byte> randomBytes(size_t size, uint32_t seed) {
+  std::mt19937 random(seed);
+  std::vector<std::byte> data(size);
+  for (auto &b : data) {
+    b = std::byte(random());
+  }
+  return data;
+}
+
+// Text-like data with repeats at every distance up to a few windows
+std::vector<std::byte> repetitive(size_t size) {
+  std::vector<std::byte> data(size);
+  for (size_t i = 0; i < size; i++) {
+    data[i] = std::byte("THE QUICK BROWN FOX "[(i * 7 / 5) % 20] ^ (i / 1000 & 3));
+  }
+  return data;
+}
+
+std::vector<std::byte> decode(std::span<const std::byte> packed, size_t size) {
+  std::vector<std::byte> out(size);
+  out.resize(unlz2k(packed, out));
+  return out;
+}
+
+// Decode through Lz2kStream, feeding piece bytes and draining drainSize
+// bytes at a time
+std::vector<std::byte> decodeStream(std::span<const std::byte> packed,
+                                    size_t size, size_t piece,
+                                    size_t drainSize) {
+  Lz2kStream stream(size);
+  std::vector<std::byte> out;
+  std::vector<std::byte> buffer(drainSize);
+  size_t fed = 0;
+  while (!stream.finished() && !stream.failed()) {
+    size_t got = stream.drain(buffer);
+    out.insert(out.end(), buffer.begin(), buffer.begin() + got);
+    if (got == 0 && stream.needsInput()) {
+      if (fed == packed.size()) {
+        break;
+      }
+      auto next = packed.subspan(fed, std::min(piece, packed.size() - fed));
+      fed += next.size();
+      stream.feed(next, fed == packed.size());
+    }
+  }
+  return out;
+}
+
+bool roundTrips(const std::vector<std::byte> &data, int level = 5) {
+  std::vector<std::byte> packed;
+  lz2k(data, packed, level);
+  if (lz2kUnpackedSize(packed) != data.size() ||
+      decode(packed, data.size()) != data) {
+    return false;
+  }
+  for (size_t piece : {size_t{1}, size_t{13}, size_t{4096}, packed.size() + 1}) {
+    if (decodeStream(packed, data.size(), piece, 1000) != data) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+TEST_CASE(emptyInput) {
+  std::vector<std::byte> packed;
+  lz2k({}, packed);
+  CHECK(packed.empty());
+  CHECK(decode(packed, 0).empty());
+  Lz2kStream stream(0);
+  stream.feed({}, true);
+  std::byte out[16];
+  CHECK(stream.drain(out) == 0);
+  CHECK(stream.finished());
+  CHECK(!stream.failed());
+}
+
+TEST_CASE(tinyInputs) {
+  CHECK(roundTrips({std::byte('A')}));
+  CHECK(roundTrips(repetitive(2)));
+  CHECK(roundTrips(repetitive(3)));
+  CHECK(roundTrips(std::vector<std::byte>(1000, std::byte(0))));
+}
+
+TEST_CASE(windowBoundaries) {
+  for (size_t size : {window - 1, window, window + 1, 2 * window + 3}) {
+    CHECK(roundTrips(repetitive(size)));
+  }
+  // A block repeated exactly one window later is still in reach, one byte
+  // further it has to be sent as literals again
+  for (size_t gap : {window - 256, window, window + 1}) {
+    auto block = randomBytes(256, 7);
+    auto data = block;
+    data.resize(gap, std::byte('-'));
+    data.insert(data.end(), block.begin(), block.end());
+    CHECK(roundTrips(data));
+  }
+}
+
+TEST_CASE(incompressibleInput) {
+  auto data = randomBytes(50000, 1);
+  std::vector<std::byte> packed;
+  lz2k(data, packed);
+  // Grows, as an entry the packer would store instead
+  CHECK(packed.size() >= data.size());
+  CHECK(roundTrips(data, 1));
+  CHECK(roundTrips(data, 9));
+}
+
+TEST_CASE(multipleChunks) {
+  auto data = repetitive(lz2kChunkSize + window + 5);
+  auto noise = randomBytes(3000, 2);
+  std::copy(noise.begin(), noise.end(), data.begin() + lz2kChunkSize - 1500);
+  CHECK(roundTrips(data));
+}
+
+TEST_CASE(bareStream) {
+  // Entries without chunk headers are one bare bit stream
+  auto data = repetitive(20000);
+  std::vector<std::byte> packed;
+  lz2k(data, packed);
+  std::span<const std::byte> bare = std::span(packed).subspan(12);
+  CHECK(lz2kUnpackedSize(bare) == 0);
+  CHECK(decode(bare, data.size()) == data);
+  CHECK(decodeStream(bare, data.size(), 100, 777) == data);
+}
+
+TEST_CASE(truncatedInputFails) {
+  auto data = repetitive(30000);
+  std::vector<std::byte> packed;
+  lz2k(data, packed);
+  auto cut = std::span<const std::byte>(packed).first(packed.size() / 2);
+  CHECK(decode(cut, data.size()).size() < data.size());
+  Lz2kStream stream(data.size());
+  stream.feed(cut, true);
+  std::vector<std::byte> out(data.size());
+  CHECK(stream.drain(out) < data.size());
+  CHECK(stream.failed());
+}
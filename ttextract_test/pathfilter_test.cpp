@@ -0,0 +1,70 @@
+// pathfilter_test.cpp : Tests for include/exclude path selection.
+
+#include "../ttextract/include/pathfilter.h"
+#include "test.h"
+
+TEST_CASE(leadingStarMatchesTopLevelAndNested) {
+  PathFilter filter;
+  filter.include("*\\LEVELS\\*.GSC");
+  CHECK(filter.matches("\\LEVELS\\CITY.GSC"));
+  CHECK(filter.matches("\\LEVELS\\CITY\\CITY.GSC"));
+  CHECK(filter.matches("\\MOD\\LEVELS\\A.GSC"));
+  CHECK(filter.matches("\\levels\\city.gsc"));
+  CHECK(!filter.matches("\\LEVELS\\CITY.TXT"));
+  CHECK(!filter.matches("\\NOTLEVELS\\A.GSC"));
+  CHECK(!filter.matches("\\CHARS\\A.GSC"));
+}
+
+TEST_CASE(anchoredPatterns) {
+  PathFilter filter;
+  filter.include("LEVELS/*.GSC");
+  CHECK(filter.matches("\\LEVELS\\A.GSC"));
+  CHECK(filter.matches("LEVELS\\A.GSC"));
+  CHECK(!filter.matches("\\MOD\\LEVELS\\A.GSC"));
+
+  PathFilter rooted;
+  rooted.include("\\CHARS\\?.TXT");
+  CHECK(rooted.matches("\\CHARS\\A.TXT"));
+  CHECK(!rooted.matches("\\CHARS\\AB.TXT"));
+}
+
+TEST_CASE(excludesOverrideIncludes) {
+  PathFilter filter;
+  filter.include("*.GSC");
+  filter.exclude("*\\TEST\\*");
+  CHECK(filter.matches("\\A.GSC"));
+  CHECK(filter.matches("\\LEVELS\\A.GSC"));
+  CHECK(!filter.matches("\\TEST\\A.GSC"));
+  CHECK(!filter.matches("\\LEVELS\\TEST\\A.GSC"));
+  CHECK(!filter.matches("\\A.TXT"));
+}
+
+TEST_CASE(regexPatterns) {
+  PathFilter filter;
+  filter.include("re:LEVELS\\\\[A-Z]+\\.GSC");
+  CHECK(filter.matches("\\LEVELS\\CITY.GSC"));
+  CHECK(filter.matches("\\levels\\city.gsc"));
+  CHECK(!filter.matches("\\LEVELS\\CITY1.GSC"));
+}
+
+TEST_CASE(mayMatchUnderPrunes) {
+  PathFilter filter;
+  filter.include("*\\LEVELS\\*.GSC");
+  CHECK(filter.mayMatchUnder(""));
+  CHECK(filter.mayMatchUnder("\\LEVELS"));
+  CHECK(filter.mayMatchUnder("\\CHARS"));
+
+  PathFilter anchored;
+  anchored.include("\\LEVELS\\CITY\\*");
+  CHECK(anchored.mayMatchUnder(""));
+  CHECK(anchored.mayMatchUnder("\\LEVELS"));
+  CHECK(anchored.mayMatchUnder("\\LEVELS\\CITY"));
+  CHECK(!anchored.mayMatchUnder("\\CHARS"));
+  CHECK(!anchored.mayMatchUnder("\\LEVELS\\TOWN"));
+
+  PathFilter excluded;
+  excluded.exclude("*\\TEST\\*");
+  CHECK(excluded.mayMatchUnder("\\LEVELS"));
+  CHECK(!excluded.mayMatchUnder("\\TEST"));
+  CHECK(!excluded.mayMatchUnder("\\LEVELS\\TEST"));
+}
@@ -0,0 +1,41 @@
+// test.cpp : Runs every registered test case and reports failures.
+
+#include "test.h"
+#include <exception>
+#include <format>
+#include <iostream>
+
+namespace {
+
+size_t failures = 0;
+
+} // namespace
+
+std::vector<testCase> &testCases() {
+  static std::vector<testCase> cases;
+  return cases;
+}
+
+void recordFailure(const char *file, int line, const std::string &expression) {
+  std::cerr << std::format("{}({}): CHECK({}) failed\n", file, line, expression);
+  ++failures;
+}
+
+int main() {
+  size_t failedCases = 0;
+  for (auto &test : testCases()) {
+    auto before = failures;
+    try {
+      test.run();
+    } catch (const std::exception &error) {
+      recordFailure(test.name, 0, std::format("threw {}", error.what()));
+    }
+    if (failures != before) {
+      std::cerr << std::format("FAILED {}\n", test.name);
+      ++failedCases;
+    }
+  }
+  std::cout << std::format("{} of {} test cases passed\n",
+                           testCases().size() - failedCases, testCases().size());
+  return failedCases ? 1 : 0;
+}
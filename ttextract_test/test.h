@@ -0,0 +1,31 @@
+#ifndef TTEXTRACT_TEST_H
+#define TTEXTRACT_TEST_H
+
+#include <string>
+#include <vector>
+
+// Minimal self-registering unit tests. A test case is a function defined with
+// TEST_CASE(name) in any file of the project; CHECK() records a failure with
+// its location and carries on, so one run reports every broken expectation.
+
+struct testCase {
+    const char* name;
+    void (*run)();
+};
+
+std::vector<testCase>& testCases();
+void recordFailure(const char* file, int line, const std::string& expression);
+
+#define TEST_CASE(name)                                                     \
+    static void name();                                                     \
+    static const bool name##Registered = (testCases().push_back({ #name, name }), true); \
+    static void name()
+
+#define CHECK(condition)                                                    \
+    do {                                                                    \
+        if (!(condition)) {                                                 \
+            recordFailure(__FILE__, __LINE__, #condition);                  \
+        }                                                                   \
+    } while (false)
+
+#endif // TTEXTRACT_TEST_H
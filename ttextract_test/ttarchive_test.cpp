@@ -0,0 +1,29 @@
+// ttarchive_test.cpp : Tests for looking up entries of an Archive.
+
+#include "../ttextract/include/datwriter.h"
+#include "../ttextract/include/ttarchive.h"
+#include "test.h"
+#include <sstream>
+#include <vector>
+
+TEST_CASE(findFoldsOnlyAsciiCase) {
+  std::stringstream stream;
+  DatWriter writer(stream, -3);
+  std::vector<std::byte> data(10, std::byte('x'));
+  CHECK(writer.add("\\Levels\\Caf\xE9.txt", data, 10, 0) == ttError::none);
+  CHECK(writer.add("\\Levels\\\xC0\xFF.bin", data, 10, 0) == ttError::none);
+  CHECK(writer.finish() == ttError::none);
+  auto text = stream.str();
+
+  std::unique_ptr<Archive> archive;
+  CHECK(Archive::open(std::as_bytes(std::span(text)), archive) == ttError::none);
+  if (!archive) {
+    return;
+  }
+  CHECK(archive->find("\\LEVELS\\CAF\xE9.TXT") != nullptr);
+  CHECK(archive->find("levels/caf\xE9.txt") != nullptr);
+  CHECK(archive->find("levels/\xC0\xFF.BIN") != nullptr);
+  // Bytes from 0x80 up aren't letters to fold, whatever the locale says
+  CHECK(archive->find("\\LEVELS\\CAF\xC9.TXT") == nullptr);
+  CHECK(archive->find("\\LEVELS\\\xE0\xFF.BIN") == nullptr);
+}